@@ -0,0 +1,100 @@
+/**
+ * @file block_pool_bench.c
+ * @brief Measures the cost of pool_block_alloc/pool_block_free depending
+ * on the pool occupancy.
+ *
+ * For each occupancy level the pool is filled, then random live blocks are
+ * released until the required occupancy is reached. After that every step
+ * frees a random live block and allocates a new one, so the occupancy stays
+ * constant while the free blocks are scattered over the whole pool.
+ *
+ * Both block layouts are measured: busy flags in the block headers (free
+ * list) and busy flags in a separate bitmap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <block_pool.h>
+
+#define CAPACITY (1 << 18)
+#define BLOCK_SIZE 32
+#define STEPS (1 << 20)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+// xorshift64, cheap enough not to distort the measurements
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    const int occupancy[] = {0, 25, 50, 75, 90, 95, 99};
+    const PoolBlockOptions layouts[] = {{ .flags = 0 }, { .flags = POOL_BLOCK_BITMAP }};
+    const char *layout_names[] = {"header", "bitmap"};
+    void **live = malloc(CAPACITY * sizeof(void *));
+    if (!live)
+        return 1;
+
+    printf("Capacity: %d blocks | Block size: %d bytes | Steps: %d\n",
+            CAPACITY, BLOCK_SIZE, STEPS);
+    printf("%8s %10s %16s\n", "layout", "occupancy", "alloc+free (ns)");
+
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); ++l)
+    for (size_t i = 0; i < sizeof(occupancy) / sizeof(occupancy[0]); ++i)
+    {
+        PoolBlock *pool = pool_block_create_ex(CAPACITY, BLOCK_SIZE, &layouts[l]);
+        if (!pool)
+            return 1;
+
+        for (size_t j = 0; j < CAPACITY; ++j)
+            live[j] = pool_block_alloc(pool);
+
+        // Leave one free block even at 100% so that the steps can proceed
+        size_t n_live = (size_t) CAPACITY * occupancy[i] / 100;
+        if (n_live == CAPACITY)
+            --n_live;
+
+        // Release random blocks, the last n_live entries stay allocated
+        for (size_t j = CAPACITY; j > n_live; --j)
+        {
+            size_t k = next_random() % j;
+            pool_block_free(pool, live[k]);
+            live[k] = live[j - 1];
+        }
+
+        double start = now_ns();
+        for (size_t j = 0; j < STEPS; ++j)
+        {
+            if (n_live == 0)
+            {
+                pool_block_free(pool, pool_block_alloc(pool));
+                continue;
+            }
+
+            size_t k = next_random() % n_live;
+            pool_block_free(pool, live[k]);
+            live[k] = pool_block_alloc(pool);
+        }
+        double elapsed = now_ns() - start;
+
+        printf("%8s %9d%% %16.1f\n", layout_names[l], occupancy[i], elapsed / STEPS);
+        pool_block_destroy(pool);
+    }
+
+    free(live);
+    return 0;
+}
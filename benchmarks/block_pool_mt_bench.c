@@ -0,0 +1,128 @@
+/**
+ * @file block_pool_mt_bench.c
+ * @brief Compares the throughput of the thread-safe block pools.
+ *
+ * Every thread repeatedly allocates a burst of blocks and frees them again.
+ * The baseline is a PoolBlock with every call wrapped in one global mutex,
+ * it is compared with the per-thread magazines and the lock-free pool.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <block_pool.h>
+#include <block_pool_mag.h>
+#include <block_pool_atomic.h>
+
+#define MAX_THREADS 8
+#define BURST 64
+#define ROUNDS 20000
+#define BLOCK_SIZE 32
+#define CAPACITY (MAX_THREADS * BURST * 4)
+
+typedef enum {
+    BENCH_MUTEX,
+    BENCH_MAGAZINE,
+    BENCH_ATOMIC,
+} BenchKind;
+
+static const char *bench_names[] = {"mutex", "magazine", "lock-free"};
+
+typedef struct {
+    BenchKind kind;
+    PoolBlock *pool;
+    pthread_mutex_t *lock;
+    PoolBlockMag *mag;
+    PoolBlockAtomic *atomic;
+} BenchArgs;
+
+static void *bench_worker(void *arg)
+{
+    BenchArgs *args = arg;
+    void *blocks[BURST];
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        for (int i = 0; i < BURST; ++i)
+        {
+            if (args->kind == BENCH_MUTEX)
+            {
+                pthread_mutex_lock(args->lock);
+                blocks[i] = pool_block_alloc(args->pool);
+                pthread_mutex_unlock(args->lock);
+            }
+            else if (args->kind == BENCH_MAGAZINE)
+                blocks[i] = pool_block_mag_alloc(args->mag);
+            else
+                blocks[i] = pool_block_atomic_alloc(args->atomic);
+        }
+
+        for (int i = 0; i < BURST; ++i)
+        {
+            if (args->kind == BENCH_MUTEX)
+            {
+                pthread_mutex_lock(args->lock);
+                pool_block_free(args->pool, blocks[i]);
+                pthread_mutex_unlock(args->lock);
+            }
+            else if (args->kind == BENCH_MAGAZINE)
+                pool_block_mag_free(args->mag, blocks[i]);
+            else
+                pool_block_atomic_free(args->atomic, blocks[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    const int thread_counts[] = {1, 2, 4, MAX_THREADS};
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    printf("Burst: %d blocks | Rounds: %d | Block size: %d bytes\n",
+            BURST, ROUNDS, BLOCK_SIZE);
+    printf("%10s %8s %18s\n", "pool", "threads", "Mops/s (alloc+free)");
+
+    for (int kind = BENCH_MUTEX; kind <= BENCH_ATOMIC; ++kind)
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t)
+    {
+        BenchArgs args = {.kind = kind, .lock = &lock};
+        if (kind == BENCH_MUTEX)
+            args.pool = pool_block_create(CAPACITY, BLOCK_SIZE);
+        else if (kind == BENCH_MAGAZINE)
+            args.mag = pool_block_mag_create(CAPACITY, BLOCK_SIZE, 0);
+        else
+            args.atomic = pool_block_atomic_create(CAPACITY, BLOCK_SIZE);
+        if (!args.pool && !args.mag && !args.atomic)
+            return 1;
+
+        pthread_t threads[MAX_THREADS];
+        double start = now_ns();
+        for (int i = 0; i < thread_counts[t]; ++i)
+            pthread_create(&threads[i], NULL, bench_worker, &args);
+        for (int i = 0; i < thread_counts[t]; ++i)
+            pthread_join(threads[i], NULL);
+        double elapsed = now_ns() - start;
+
+        double ops = (double) thread_counts[t] * ROUNDS * BURST;
+        printf("%10s %8d %18.2f\n", bench_names[kind], thread_counts[t], ops / elapsed * 1e3);
+
+        if (kind == BENCH_MUTEX)
+            pool_block_destroy(args.pool);
+        else if (kind == BENCH_MAGAZINE)
+            pool_block_mag_destroy(args.mag);
+        else
+            pool_block_atomic_destroy(args.atomic);
+    }
+
+    return 0;
+}
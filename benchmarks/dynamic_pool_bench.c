@@ -0,0 +1,107 @@
+/**
+ * @file dynamic_pool_bench.c
+ * @brief Measures the cost of pool_dyn_alloc/pool_dyn_free depending on
+ * the number of live blocks, for the first fit and the TLSF index with
+ * either block header layout. The default layout is measured at every
+ * integrity level: canaries (no suffix), no checks and CRC32C.
+ *
+ * The pool is filled with the required number of blocks of random sizes.
+ * After that every step frees a random live block and allocates a new one
+ * of a random size. Besides the mean the slowest step is reported, as the
+ * first fit walks over all blocks in front of the free one it finds.
+ * The pool memory taken per live block shows the cost of the headers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <dynamic_pool.h>
+
+#define MAX_LIVE 4096
+#define MIN_SIZE 16
+#define MAX_SIZE 256
+#define STEPS (1 << 16)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+// xorshift64, cheap enough not to distort the measurements
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static size_t random_size(void)
+{
+    return MIN_SIZE + next_random() % (MAX_SIZE - MIN_SIZE + 1);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    const size_t live_counts[] = {16, 256, MAX_LIVE};
+    const PoolDynOptions modes[] = {
+        { .flags = 0, .integrity = POOL_DYN_INTEGRITY_CANARY },
+        { .flags = 0, .integrity = POOL_DYN_INTEGRITY_NONE },
+        { .flags = 0, .integrity = POOL_DYN_INTEGRITY_CHECKSUM },
+        { .flags = POOL_DYN_TLSF, .integrity = POOL_DYN_INTEGRITY_CANARY },
+        { .flags = POOL_DYN_TLSF, .integrity = POOL_DYN_INTEGRITY_NONE },
+        { .flags = POOL_DYN_TLSF, .integrity = POOL_DYN_INTEGRITY_CHECKSUM },
+        { .flags = POOL_DYN_COMPACT },
+        { .flags = POOL_DYN_COMPACT | POOL_DYN_TLSF }};
+    const char *mode_names[] = {"first-fit", "ff-none", "ff-crc32c", "tlsf", "tlsf-none",
+        "tlsf-crc32c", "compact", "compact-tlsf"};
+    void **live = malloc(MAX_LIVE * sizeof(void *));
+    if (!live)
+        return 1;
+
+    printf("Block size: %d..%d bytes | Steps: %d\n", MIN_SIZE, MAX_SIZE, STEPS);
+    printf("%12s %8s %16s %14s %12s\n", "mode", "live", "alloc+free (ns)", "slowest (ns)",
+            "bytes/block");
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    for (size_t i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); ++i)
+    {
+        size_t n_live = live_counts[i];
+        PoolDyn *pool = pool_dyn_create_ex(2 * n_live * (MAX_SIZE + sizeof(MetaData)),
+                &modes[m]);
+        if (!pool)
+            return 1;
+
+        rng_state = 0x9E3779B97F4A7C15;
+        for (size_t j = 0; j < n_live; ++j)
+            live[j] = pool_dyn_alloc_safe(pool, random_size());
+
+        double slowest = 0;
+        double start = now_ns();
+        for (size_t j = 0; j < STEPS; ++j)
+        {
+            size_t k = next_random() % n_live;
+            double step_start = now_ns();
+            pool_dyn_free(pool, live[k]);
+            live[k] = pool_dyn_alloc_safe(pool, random_size());
+            double step = now_ns() - step_start;
+            if (step > slowest)
+                slowest = step;
+            if (!live[k])
+                return 1;
+        }
+        double elapsed = now_ns() - start;
+
+        printf("%12s %8zu %16.1f %14.0f %12.1f\n", mode_names[m], n_live, elapsed / STEPS,
+                slowest, (double) pool_dyn_size(pool) / n_live);
+        pool_dyn_destroy(pool);
+    }
+
+    free(live);
+    return 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file huge_pages_bench.c
+ * @brief Measures random access to large pools backed by base pages and
+ * by huge pages.
+ *
+ * A block pool and a dynamic pool (TLSF) of the given size are half
+ * filled with blocks. Then every step frees a random live block,
+ * allocates a new one and writes its first cache line, and a final pass
+ * reads random live blocks. The blocks are spread over the whole pool, so
+ * nearly every access lands on another page and the cost is dominated by
+ * TLB misses.
+ *
+ * Usage: huge_pages_bench [pool size in GiB, default 1]
+ * The pools touch about their whole size, the 8 GiB run needs that much
+ * free memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <block_pool.h>
+#include <dynamic_pool.h>
+
+#define BLOCK_SIZE 256
+#define MIN_SIZE 64
+#define MAX_SIZE 1024
+#define STEPS (1 << 20)
+#define READS (1 << 22)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+// xorshift64, cheap enough not to distort the measurements
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static size_t random_size(void)
+{
+    return MIN_SIZE + next_random() % (MAX_SIZE - MIN_SIZE + 1);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const char *pages_name(PoolPagesKind pages)
+{
+    switch (pages)
+    {
+    case POOL_PAGES_HUGETLB:
+        return "hugetlb";
+    case POOL_PAGES_THP:
+        return "thp";
+    default:
+        return "base";
+    }
+}
+
+// Reads the first byte of random live blocks, returns ns per read
+static double random_reads(unsigned char **live, size_t n_live)
+{
+    unsigned int sum = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < READS; ++i)
+        sum += *live[next_random() % n_live];
+    double elapsed = now_ns() - start;
+
+    // Keeps the reads from being optimized out
+    if (sum == 1)
+        printf(" ");
+    return elapsed / READS;
+}
+
+static int bench_block(size_t pool_bytes, bool huge, unsigned char **live, unsigned char **gaps)
+{
+    size_t capacity = pool_bytes / BLOCK_SIZE;
+    size_t n_live = capacity / 2;
+    PoolBlockOptions options = { .flags = huge ? POOL_BLOCK_HUGE_PAGES : 0 };
+    PoolBlock *pool = pool_block_create_ex(capacity, BLOCK_SIZE, &options);
+    if (!pool)
+        return 1;
+
+    // Every other block stays allocated, so the live blocks span the pool
+    rng_state = 0x9E3779B97F4A7C15;
+    for (size_t i = 0; i < n_live; ++i)
+    {
+        live[i] = pool_block_alloc(pool);
+        gaps[i] = pool_block_alloc(pool);
+        live[i][0] = gaps[i][0] = (unsigned char) i;
+    }
+    for (size_t i = 0; i < n_live; ++i)
+        pool_block_free(pool, gaps[i]);
+
+    double start = now_ns();
+    for (size_t i = 0; i < STEPS; ++i)
+    {
+        size_t k = next_random() % n_live;
+        pool_block_free(pool, live[k]);
+        live[k] = pool_block_alloc(pool);
+        memset(live[k], (int) i, 64);
+    }
+    double steps = (now_ns() - start) / STEPS;
+
+    printf("%8s %8s %10zu %16.1f %12.1f\n", "block", pages_name(pool->slabs->pages),
+            n_live, steps, random_reads(live, n_live));
+    pool_block_destroy(pool);
+    return 0;
+}
+
+static int bench_dyn(size_t pool_bytes, bool huge, unsigned char **live, unsigned char **gaps)
+{
+    PoolDynOptions options = { .flags = POOL_DYN_TLSF | (huge ? POOL_DYN_HUGE_PAGES : 0) };
+    PoolDyn *pool = pool_dyn_create_ex(pool_bytes, &options);
+    if (!pool)
+        return 1;
+
+    // Blocks of random sizes fill half of the pool, separated by free ones
+    rng_state = 0x9E3779B97F4A7C15;
+    size_t n_live = 0;
+    while (pool_dyn_size(pool) < pool_dyn_capacity(pool) / 2 - MAX_SIZE)
+    {
+        live[n_live] = pool_dyn_alloc(pool, random_size());
+        gaps[n_live] = pool_dyn_alloc(pool, random_size());
+        if (!live[n_live] || !gaps[n_live])
+            return 1;
+        live[n_live][0] = gaps[n_live][0] = (unsigned char) n_live;
+        ++n_live;
+    }
+    for (size_t i = 0; i < n_live; ++i)
+        pool_dyn_free(pool, gaps[i]);
+
+    double start = now_ns();
+    for (size_t i = 0; i < STEPS; ++i)
+    {
+        size_t k = next_random() % n_live;
+        pool_dyn_free(pool, live[k]);
+        live[k] = pool_dyn_alloc(pool, random_size());
+        if (!live[k])
+            return 1;
+        memset(live[k], (int) i, 64);
+    }
+    double steps = (now_ns() - start) / STEPS;
+
+    printf("%8s %8s %10zu %16.1f %12.1f\n", "dynamic", pages_name(pool->pages),
+            n_live, steps, random_reads(live, n_live));
+    pool_dyn_destroy(pool);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t gib = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1;
+    size_t pool_bytes = gib << 30;
+    size_t max_live = pool_bytes / BLOCK_SIZE / 2;
+    unsigned char **live = malloc(max_live * sizeof(void *));
+    unsigned char **gaps = malloc(max_live * sizeof(void *));
+    if (!pool_bytes || !live || !gaps)
+        return 1;
+
+    printf("Pool size: %zu GiB | Steps: %d | Reads: %d\n", gib, STEPS, READS);
+    printf("%8s %8s %10s %16s %12s\n", "pool", "pages", "live",
+            "alloc+free (ns)", "read (ns)");
+
+    for (int huge = 0; huge < 2; ++huge)
+    {
+        if (bench_block(pool_bytes, huge, live, gaps) ||
+                bench_dyn(pool_bytes, huge, live, gaps))
+            return 1;
+    }
+
+    free(gaps);
+    free(live);
+    return 0;
+}
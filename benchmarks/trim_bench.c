@@ -0,0 +1,157 @@
+/**
+ * @file trim_bench.c
+ * @brief Measures the resident memory of the pools after a burst, with
+ * and without trimming, and the cost of faulting the pages back in.
+ *
+ * A burst fills a pool with blocks that are written and then freed, all
+ * but a few blocks spread over the pool. The resident set is read from
+ * /proc/self/statm after the burst, after the trim and after the next
+ * burst, which pays for the released pages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <block_pool.h>
+#include <dynamic_pool.h>
+
+#define POOL_BYTES ((size_t) 256 << 20)
+#define BLOCK_SIZE 256
+#define DYN_BLOCK_SIZE 4096
+#define KEPT_EVERY 4096
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Resident set of the process in MiB
+static double rss_mib(void)
+{
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%*s %ld", &pages) != 1)
+            pages = 0;
+        fclose(statm);
+    }
+    return (double) pages * sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+static void report(const char *pool, double base, double burst, double trimmed,
+        double trim_ms, double burst_ms, double reburst_ms)
+{
+    printf("%8s %12.1f %12.1f %10.2f %12.1f %14.1f\n", pool, burst - base, trimmed - base,
+            trim_ms, burst_ms, reburst_ms);
+}
+
+static int bench_block(void **blocks, size_t count)
+{
+    PoolBlockOptions options = { .flags = POOL_BLOCK_BITMAP };
+    PoolBlock *pool = pool_block_create_ex(count, BLOCK_SIZE, &options);
+    if (!pool)
+        return 1;
+
+    double base = rss_mib(), burst_ms = 0, reburst_ms = 0, burst = 0, trimmed = 0, trim_ms = 0;
+    for (int round = 0; round < 2; ++round)
+    {
+        double start = now_ns();
+        for (size_t i = 0; i < count; ++i)
+        {
+            blocks[i] = pool_block_alloc(pool);
+            memset(blocks[i], (int) i, BLOCK_SIZE);
+        }
+        for (size_t i = 0; i < count; ++i)
+            if (i % KEPT_EVERY)
+                pool_block_free(pool, blocks[i]);
+        double elapsed = (now_ns() - start) / 1e6;
+        if (round)
+        {
+            reburst_ms = elapsed;
+            break;
+        }
+
+        burst_ms = elapsed;
+        burst = rss_mib();
+        start = now_ns();
+        pool_block_trim(pool);
+        trim_ms = (now_ns() - start) / 1e6;
+        trimmed = rss_mib();
+        for (size_t i = 0; i < count; i += KEPT_EVERY)
+            pool_block_free(pool, blocks[i]);
+    }
+
+    report("block", base, burst, trimmed, trim_ms, burst_ms, reburst_ms);
+    pool_block_destroy(pool);
+    return 0;
+}
+
+static int bench_dyn(void **blocks, size_t count)
+{
+    PoolDynOptions options = { .flags = POOL_DYN_TLSF, .growth = POOL_DYN_GROW_DOUBLE };
+    PoolDyn *pool = pool_dyn_create_ex(POOL_BYTES, &options);
+    if (!pool)
+        return 1;
+
+    double base = rss_mib(), burst_ms = 0, reburst_ms = 0, burst = 0, trimmed = 0, trim_ms = 0;
+    for (int round = 0; round < 2; ++round)
+    {
+        double start = now_ns();
+        for (size_t i = 0; i < count; ++i)
+        {
+            blocks[i] = pool_dyn_alloc(pool, DYN_BLOCK_SIZE - sizeof(MetaData));
+            if (!blocks[i])
+                return 1;
+            memset(blocks[i], (int) i, DYN_BLOCK_SIZE - sizeof(MetaData));
+        }
+        for (size_t i = 0; i < count; ++i)
+            if (i % (KEPT_EVERY / 16))
+                pool_dyn_free(pool, blocks[i]);
+        double elapsed = (now_ns() - start) / 1e6;
+        if (round)
+        {
+            reburst_ms = elapsed;
+            break;
+        }
+
+        burst_ms = elapsed;
+        burst = rss_mib();
+        start = now_ns();
+        pool_dyn_trim(pool);
+        trim_ms = (now_ns() - start) / 1e6;
+        trimmed = rss_mib();
+        for (size_t i = 0; i < count; i += KEPT_EVERY / 16)
+            pool_dyn_free(pool, blocks[i]);
+    }
+
+    report("dynamic", base, burst, trimmed, trim_ms, burst_ms, reburst_ms);
+    pool_dyn_destroy(pool);
+    return 0;
+}
+
+int main(void)
+{
+    size_t count = POOL_BYTES / BLOCK_SIZE;
+    void **blocks = malloc(count * sizeof(void *));
+    if (!blocks)
+        return 1;
+
+    printf("Burst: %zu MiB | Kept: 1 of %d blocks (block), 1 of %d (dynamic)\n",
+            POOL_BYTES >> 20, KEPT_EVERY, KEPT_EVERY / 16);
+    printf("%8s %12s %12s %10s %12s %14s\n", "pool", "burst (MiB)", "trimmed (MiB)",
+            "trim (ms)", "burst (ms)", "reburst (ms)");
+
+    // The block array is written before the first measurement
+    memset(blocks, 0, count * sizeof(void *));
+    if (bench_block(blocks, count) || bench_dyn(blocks, POOL_BYTES / DYN_BLOCK_SIZE))
+        return 1;
+
+    free(blocks);
+    return 0;
+}
@@ -2,38 +2,163 @@
  * @file: block_pool.h
  * @brief: Implementation of a memory pool based on a two-dimensional array.
  *
- * The memory pool stores fixed-size elements. The first byte of each
- * element is used as a busy flag.
+ * The memory pool stores fixed-size elements. Each element is preceded by
+ * a header word: an occupied block stores BLOCK_BUSY there, a free block
+ * stores the address of the next free block. Free blocks thus form an
+ * intrusive LIFO list, so allocation and release take constant time.
+ *
+ * Alternatively (POOL_BLOCK_BITMAP) the busy flags are kept in a separate
+ * bitmap and the blocks carry no header at all. Free blocks are then found
+ * by scanning the bitmap a 64-bit word at a time.
+ *
+ * The blocks live in one or more slabs. A fixed-size pool has exactly one
+ * slab; a growable pool acquires a new slab when it is exhausted and
+ * releases slabs that become completely empty. Slabs never move, so block
+ * addresses stay stable.
+ *
+ * A cleanup only rewinds the high-water mark of every slab (the untouched
+ * part in the header layout, the bitmap words in use in the bitmap
+ * layout). The blocks above the mark are free whatever their headers or
+ * bitmap bits say, and they are reset lazily when allocation reaches them.
+ * A cleanup thus costs the same whatever the capacity, and freeing a block
+ * allocated before it is detected unless the block was handed out again.
+ *
+ * Slab buffers are aligned to whole pages and registered in the global
+ * pool registry, so the slab of a block is found in constant time however
+ * many slabs (and pools) there are. With POOL_BLOCK_HUGE_PAGES they are
+ * rounded up to whole huge pages and backed by them where the system has
+ * them (see pool_pages_alloc_huge).
  */
 
 #ifndef BLOCK_POOL_H
 #define BLOCK_POOL_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pool_pages.h>
 
-// Using to align memory addresses. This value must be STRICTLY a power of 2.
+// Default alignment of the blocks. This value must be STRICTLY a power of 2.
 #define BLOCK_POOL_ALIGNMENT 8
 
+// Size of the cache line, used to keep the shared data apart.
+#define CACHE_LINE_SIZE 64
+
+// Header value of an occupied block. Free blocks store the (aligned, so even)
+// address of the next free block in the header instead.
+#define BLOCK_BUSY ((uintptr_t) 1)
+
 // Minimum size of allocated block. Must be a multiple of alignment.
 //#define MIN_BLOCK_SIZE 4
 
 // Round up to the nearest multiple.
-#define MULTIPLE_UP(value, multiple) ((value) + (((multiple) - 1)) & \
+#define MULTIPLE_UP(value, multiple) (((value) + ((multiple) - 1)) & \
         ~((multiple) - 1))
 
+// Pool creation flags
+#define POOL_BLOCK_BITMAP 0x1   // Busy flags are stored in a separate bitmap
+#define POOL_BLOCK_CACHE_ALIGNED 0x2    // Blocks occupy whole cache lines
+#define POOL_BLOCK_HANDLES 0x4  // Blocks can be referenced by handles
+#define POOL_BLOCK_HUGE_PAGES 0x8   // Slab buffers are backed by huge pages
+
+// Largest capacity of a pool with handles, the rest of the handle bits
+// (at least 8) hold the generation.
+#define POOL_HANDLE_MAX_CAPACITY ((size_t) 1 << 24)
+
+// Handle that never refers to a block.
+#define POOL_NULL_HANDLE 0
+
+/* Compact reference to a block: index in the low bits, generation above */
+typedef uint32_t PoolHandle;
+
+// Largest supported block alignment: the slab buffers are aligned to pages.
+#define BLOCK_POOL_MAX_ALIGNMENT 4096
+
+// Number of blocks described by one bitmap word.
+#define BITMAP_WORD_BITS 64
+
 typedef unsigned char byte;
 
+/* How the pool grows when it runs out of free blocks */
+typedef enum {
+    POOL_GROW_NONE = 0, // The pool has a fixed capacity.
+    POOL_GROW_DOUBLE,   // Each new slab doubles the pool capacity.
+    POOL_GROW_FIXED,    // Each new slab adds growth_step blocks.
+} PoolBlockGrowth;
+
+/* Additional pool creation parameters */
+typedef struct pool_block_options {
+    unsigned int flags;         // Combination of POOL_BLOCK_* flags.
+    PoolBlockGrowth growth;     // Growth policy.
+    size_t growth_step;         // Slab capacity for POOL_GROW_FIXED.
+    size_t alignment;           // Alignment of the blocks (power of 2),
+                                // 0 for BLOCK_POOL_ALIGNMENT.
+    size_t trim_threshold;      // A slab that becomes empty after using at
+                                // least this many bytes is trimmed
+                                // (see pool_block_trim), 0 to never trim.
+} PoolBlockOptions;
+
+/* Contiguous region of pool blocks */
+typedef struct block_slab {
+    struct block_slab *next;            // Next slab of the pool.
+    struct block_slab *prev;            // Previous slab of the pool.
+    struct block_slab *next_partial;    // Next slab with free blocks.
+    struct block_slab *prev_partial;    // Previous slab with free blocks.
+    struct pool_block *pool;            // Pool the slab belongs to.
+    void *mem;          // Pointer to the slab buffer.
+    size_t capacity;    // Number of blocks in the slab.
+    size_t size;        // The number of occupied slab blocks.
+    void *free_list;    // Header of the last freed block (head of the
+                        // free list).
+    void *untouched;    // First block not allocated since the last cleanup.
+    void *zeroed;       // Blocks from here on were never allocated, their
+                        // memory is still zero.
+    size_t hint;        // Index of the first bitmap word that may
+                        // have a free block.
+    size_t fresh;       // Number of bitmap words in use since the last
+                        // cleanup, the following words are free.
+    PoolPagesKind pages;    // Pages backing the slab buffer.
+    uint64_t bitmap[];  // Busy flags (one bit per block), empty if
+                        // the flags are stored in the block headers.
+} BlockSlab;
+
 /* Defining the structure of a memory pool */
 typedef struct pool_block {
-    void *mem_pool;     // Pointer to the pool bubber.
-    size_t capacity;    // Maximum number of pool elements.
+    void *mem_pool;     // Pointer to the buffer of the first slab.
+    size_t capacity;    // Maximum number of pool elements (all slabs).
     size_t block_size;  // The size of one element in bytes.
     size_t size;        // The number of occupied pool blocks.
     size_t offset;      // Offset of the data field relative to the
                         // beginning of the block.
-    void *last_clear;   // Pointer to the last cleared block.
+    BlockSlab *slabs;   // All the slabs of the pool.
+    BlockSlab *partial; // Slabs that have free blocks.
+    BlockSlab *empty;   // Completely free slab kept to avoid thrashing
+                        // on the growth boundary.
+    unsigned int flags; // Flags the pool was created with.
+    PoolBlockGrowth growth; // Growth policy.
+    size_t growth_step;     // Slab capacity for POOL_GROW_FIXED.
+    size_t alignment;       // Alignment of the blocks.
+    BlockSlab *pinned;      // Slab being visited by pool_block_foreach,
+                            // it is not released while it is empty.
+    uint32_t *generations;  // Generation of every block, changed by each
+                            // allocation (POOL_BLOCK_HANDLES only).
+    unsigned int handle_bits;   // Number of index bits in a handle.
+    size_t trim_threshold;  // Extent of an empty slab to trim it at (bytes).
 } PoolBlock;
 
+/* Function called for every busy block by the iteration */
+typedef void (*PoolBlockVisitor)(void *memblock, void *ctx);
+
+/* Cursor over the busy blocks of a pool */
+typedef struct pool_block_iter {
+    const PoolBlock *pool;  // Pool being iterated.
+    BlockSlab *slab;        // Slab being visited, NULL at the end.
+    size_t index;           // Index of the next block (or bitmap word
+                            // start) to check in the slab.
+    uint64_t bits;          // Busy blocks of the current bitmap word
+                            // that were not returned yet.
+} PoolBlockIter;
+
 /**
  * @brief: Creates a memmory pool.
  *
@@ -48,6 +173,43 @@ typedef struct pool_block {
  */
 PoolBlock *pool_block_create(size_t capacity, size_t block_size);
 
+/**
+ * @brief: Creates a memory pool with additional parameters.
+ *
+ * @param capacity: Memory pool size.
+ * @param block_size: The size of one element in bytes.
+ * @param options: Creation parameters, NULL for the defaults.
+ * @return: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_INVALID_ARGS: Invalid arguments passed.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory for pool.
+ */
+PoolBlock *pool_block_create_ex(size_t capacity, size_t block_size,
+        const PoolBlockOptions *options);
+
+/**
+ * @brief: Creates a memory pool with aligned blocks.
+ *
+ * In the header layout the header takes a whole alignment unit in front
+ * of each block, so large alignments are better served by the bitmap layout
+ * (pool_block_create_ex with POOL_BLOCK_BITMAP and the alignment).
+ *
+ * @param capacity: Memory pool size.
+ * @param block_size: The size of one element in bytes.
+ * @param alignment: Alignment of the blocks, a power of 2 not greater than
+ * BLOCK_POOL_MAX_ALIGNMENT.
+ * @return: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_INVALID_ARGS: Invalid arguments passed.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory for pool.
+ */
+PoolBlock *pool_block_create_aligned(size_t capacity, size_t block_size,
+        size_t alignment);
+
 /**
  * @brief: Requests memory from the pool.
  *
@@ -60,6 +222,40 @@ PoolBlock *pool_block_create(size_t capacity, size_t block_size);
  */
 void *pool_block_alloc(PoolBlock *pool);
 
+/**
+ * @brief: Requests zero-filled memory from the pool.
+ *
+ * The slab buffers come zero-filled from the system, and every slab
+ * remembers up to where its blocks were ever allocated. Blocks above that
+ * mark are returned without clearing, only recycled blocks are cleared.
+ *
+ * @param pool: Pointer to the memoty pool.
+ * @return: Pointer to the zero-filled block, NULL if an error occurred.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory.
+ */
+void *pool_block_calloc(PoolBlock *pool);
+
+/**
+ * @brief: Requests several blocks from the pool at once.
+ *
+ * The checks, the counters and the logging are done once per batch.
+ *
+ * @param pool: Pointer to the memoty pool.
+ * @param out: Array receiving the pointers to the allocated blocks.
+ * @param n: Number of blocks requested.
+ * @return: Number of allocated blocks (the first entries of out).
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or out pointer is NULL.
+ *          -POOL_ALLOC_FAILED: Fewer than n blocks were available.
+ */
+size_t pool_block_alloc_n(PoolBlock *pool, void **out, size_t n);
+
 /**
  * @brief: Frees previously allocated memory.
  *
@@ -74,6 +270,141 @@ void *pool_block_alloc(PoolBlock *pool);
  */
 void pool_block_free(PoolBlock *pool, void *memblock);
 
+/**
+ * @brief: Frees several previously allocated blocks at once.
+ *
+ * The invalid pointers are skipped, the rest of the batch is freed.
+ *
+ * @param pool: Pointer to the memory pool from which the
+ * freed blocks were allocated.
+ * @param in: Array of pointers to the blocks to be freed.
+ * @param n: Number of pointers in the array.
+ * @return: Number of freed blocks.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or in pointer (or one of the blocks) is NULL.
+ *          -POOL_INVALID_PTR: One of the pointers is not an occupied block
+ *          of the pool.
+ */
+size_t pool_block_free_n(PoolBlock *pool, void **in, size_t n);
+
+/**
+ * @brief: Requests memory from the pool and returns a handle to it.
+ *
+ * The pool must be created with POOL_BLOCK_HANDLES. Such pools have
+ * a fixed capacity of at most POOL_HANDLE_MAX_CAPACITY blocks.
+ *
+ * @param pool: Pointer to the memoty pool.
+ * @return: Handle of the block, POOL_NULL_HANDLE if an error occurred.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_INVALID_ARGS: The pool has no handles.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory.
+ */
+PoolHandle pool_block_alloc_handle(PoolBlock *pool);
+
+/**
+ * @brief: Returns the block the handle refers to.
+ *
+ * The block address is computed from the index with one multiply-add.
+ * Every allocation changes the generation of the block, so a handle of
+ * a block that was freed (or cleared) and allocated again does not match.
+ *
+ * @param pool: Pointer to the memory pool.
+ * @param handle: Handle returned by pool_block_alloc_handle.
+ * @return: Pointer to the block, NULL if the handle is stale or invalid.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_INVALID_PTR: The handle does not refer to a busy block.
+ */
+void *pool_block_deref(const PoolBlock *pool, PoolHandle handle);
+
+/**
+ * @brief: Frees the block the handle refers to.
+ *
+ * @param pool: Pointer to the memory pool.
+ * @param handle: Handle returned by pool_block_alloc_handle.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_INVALID_PTR: The handle does not refer to a busy block.
+ */
+void pool_block_free_handle(PoolBlock *pool, PoolHandle handle);
+
+/**
+ * @brief: Checking if a block is included in the memory pool.
+ *
+ * @param pool: Pointer to the memory pool.
+ * @param memblock: Pointer to a memory block.
+ * @return: 'true' if the memory block is in one of the pool slabs and
+ * corectly aligned, otherwise 'false'.
+ */
+bool pool_block_contains(const PoolBlock *pool, const void *memblock);
+
+/**
+ * @brief: Calls the visitor for every busy block of the pool.
+ *
+ * The blocks of each slab are visited in address order. In the bitmap
+ * layout the words without busy blocks are skipped as a whole.
+ *
+ * The visitor may free the visited block, the pool must not be changed
+ * otherwise during the iteration.
+ *
+ * @param pool: Pointer to the memory pool.
+ * @param visitor: Function called with every busy block.
+ * @param ctx: Argument passed to the visitor.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or visitor pointer is NULL.
+ */
+void pool_block_foreach(PoolBlock *pool, PoolBlockVisitor visitor, void *ctx);
+
+/**
+ * @brief: Calls the visitor for every busy block, splitting the pool into
+ * ranges visited by several threads.
+ *
+ * The ranges start at bitmap word boundaries. The visitor is called
+ * concurrently and must not change the pool.
+ *
+ * @param pool: Pointer to the memory pool.
+ * @param visitor: Function called with every busy block.
+ * @param ctx: Argument passed to the visitor.
+ * @param threads: Number of threads (including the calling one).
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or visitor pointer is NULL.
+ *          -POOL_INVALID_ARGS: threads is 0.
+ */
+void pool_block_foreach_parallel(PoolBlock *pool, PoolBlockVisitor visitor, void *ctx,
+        size_t threads);
+
+/**
+ * @brief: Places the cursor in front of the first busy block of the pool.
+ *
+ * The pool must not be changed while the cursor is used, except for
+ * freeing the returned blocks of a fixed-size pool.
+ *
+ * @param iter: Cursor to initialize.
+ * @param pool: Pointer to the memory pool.
+ */
+void pool_block_iter_init(PoolBlockIter *iter, const PoolBlock *pool);
+
+/**
+ * @brief: Returns the next busy block of the pool.
+ *
+ * @param iter: Cursor initialized by pool_block_iter_init.
+ * @return: Pointer to the block, NULL if all the blocks were returned.
+ */
+void *pool_block_iter_next(PoolBlockIter *iter);
+
 /**
  * @brief: Frees all pool memory blocks.
  *
@@ -85,6 +416,27 @@ void pool_block_free(PoolBlock *pool, void *memblock);
  */
 void pool_block_clear(PoolBlock *pool);
 
+/**
+ * @brief: Gives the pages of the free blocks back to the system.
+ *
+ * A slab without busy blocks is rewound and all its pages are released.
+ * Otherwise the pages above the high-water mark are released, and in the
+ * bitmap layout also the pages covered by free blocks only (in the header
+ * layout a free block holds the link of the free list). The pages are
+ * committed again, zero-filled, when the blocks are reused.
+ *
+ * A pool created with a trim_threshold trims every slab that becomes
+ * empty after using at least that many bytes.
+ *
+ * @param pool: Pointer to the memory pool.
+ * @return: Number of bytes released.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+size_t pool_block_trim(PoolBlock *pool);
+
 /**
  * @brief: Destroys the pool and frees the memory.
  *
@@ -0,0 +1,128 @@
+/**
+ * @file: block_pool_atomic.h
+ * @brief: Lock-free block pool.
+ *
+ * Free blocks form a Treiber stack linked through the block headers. The
+ * top of the stack is a single 64-bit word holding the index of the top
+ * block and a tag that is incremented by every push and pop, so a thread
+ * that was preempted between reading the top and swapping it cannot be
+ * fooled by the same block coming back on top (ABA problem).
+ *
+ * The pool holds at most UINT32_MAX - 1 blocks.
+ */
+
+#ifndef BLOCK_POOL_ATOMIC_H
+#define BLOCK_POOL_ATOMIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <block_pool.h>
+
+// Header value of an occupied block. Free blocks store the index + 1 of
+// the next free block in the low half of the header, 0 ends the stack.
+#define ATOMIC_BLOCK_BUSY ((uint64_t) 1 << 63)
+
+/* Lock-free block pool */
+typedef struct pool_block_atomic {
+    void *mem_pool;     // Pointer to the pool buffer.
+    size_t capacity;    // Maximum number of pool elements.
+    size_t block_size;  // The size of one element in bytes.
+    size_t offset;      // Offset of the data field relative to the
+                        // beginning of the block.
+
+    // Every field changed by all threads lives on its own cache line.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;    // Tag (high half) and
+                                                        // index + 1 of the top.
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t untouched;  // Index of the first
+                                                        // never allocated block.
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t size;       // The number of
+                                                        // occupied pool blocks.
+} PoolBlockAtomic;
+
+/**
+ * @brief: Creates a lock-free memory pool.
+ *
+ * @param capacity: Memory pool size.
+ * @param block_size: The size of one element in bytes.
+ * @return: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_INVALID_ARGS: Invalid arguments passed.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory for pool.
+ */
+PoolBlockAtomic *pool_block_atomic_create(size_t capacity, size_t block_size);
+
+/**
+ * @brief: Requests memory from the pool. Safe to call from any thread.
+ *
+ * @param pool: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory.
+ */
+void *pool_block_atomic_alloc(PoolBlockAtomic *pool);
+
+/**
+ * @brief: Frees previously allocated memory. Safe to call from any thread.
+ *
+ * @param pool: Pointer to the memory pool from which the
+ * freed block was allocated.
+ * @param memblock: Pointer to a block of memory allocated
+ * from the pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or memblock pointer is NULL.
+ *          -POOL_INVALID_PTR: memblock is not an occupied block of the pool.
+ */
+void pool_block_atomic_free(PoolBlockAtomic *pool, void *memblock);
+
+/**
+ * @brief: Frees all pool memory blocks.
+ *
+ * No other thread may use the pool at this point.
+ *
+ * @param pool: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+void pool_block_atomic_clear(PoolBlockAtomic *pool);
+
+/**
+ * @brief: Destroys the pool and frees the memory.
+ *
+ * No other thread may use the pool at this point.
+ *
+ * @param pool: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+void pool_block_atomic_destroy(PoolBlockAtomic *pool);
+
+/**
+ * @brief Returns the current size of the pool's occupied space.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+size_t pool_block_atomic_size(PoolBlockAtomic *pool);
+
+/**
+ * @brief Returns the total size of the pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+size_t pool_block_atomic_capacity(PoolBlockAtomic *pool);
+
+#endif // BLOCK_POOL_ATOMIC_H
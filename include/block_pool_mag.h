@@ -0,0 +1,140 @@
+/**
+ * @file: block_pool_mag.h
+ * @brief: Thread-safe front end of the block pool with per-thread magazines.
+ *
+ * Every thread keeps two magazines (stacks of free blocks) for each pool it
+ * uses. Allocation and release work on the magazines of the calling thread
+ * and take no lock. Only when both magazines are empty (or full) the thread
+ * exchanges a magazine with the shared depot, which is guarded by a mutex
+ * and refills itself from the backing PoolBlock.
+ *
+ * Blocks cached in the magazines of one thread are not available to the
+ * other threads, so an allocation may fail while some blocks are still
+ * cached elsewhere. Double frees are not detected on the magazine path.
+ */
+
+#ifndef BLOCK_POOL_MAG_H
+#define BLOCK_POOL_MAG_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <block_pool.h>
+
+// Number of blocks in one magazine if no value is specified.
+#define DEFAULT_MAGAZINE_SIZE 32
+
+/* Stack of free blocks */
+typedef struct block_magazine {
+    struct block_magazine *next;    // Next magazine in the depot list.
+    size_t rounds;                  // Number of blocks in the magazine.
+    void *blocks[];                 // Cached blocks.
+} BlockMagazine;
+
+/* Magazines of one thread */
+typedef struct mag_cache {
+    struct mag_cache *next;         // Next cache of the pool.
+    struct mag_cache *prev;         // Previous cache of the pool.
+    struct pool_block_mag *pool;    // Pool the cache belongs to.
+    BlockMagazine *loaded;          // Magazine the blocks are taken from.
+    BlockMagazine *previous;        // Spare magazine.
+    atomic_size_t cached;           // Blocks in both magazines, written by
+                                    // the thread only, read by the size query.
+} MagCache;
+
+/* Thread-safe block pool */
+typedef struct pool_block_mag {
+    PoolBlock *pool;                // Backing pool.
+    size_t magazine_size;           // Number of blocks in a full magazine.
+    pthread_key_t key;              // Cache of the calling thread.
+    // Copies of the fixed bounds of the backing slab, so the lock-free
+    // path never reads the lines the depot writes.
+    const byte *first;              // First block of the backing pool.
+    const byte *end;                // End of the last block.
+    size_t block_size;              // Size of one block.
+
+    // The depot is changed by all threads, keep it off the read-only data.
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+    BlockMagazine *full;            // Magazines with magazine_size blocks.
+    BlockMagazine *empty;           // Magazines without blocks.
+    MagCache *caches;               // Caches of all threads.
+} PoolBlockMag;
+
+/**
+ * @brief: Creates a thread-safe memory pool.
+ *
+ * @param capacity: Memory pool size.
+ * @param block_size: The size of one element in bytes.
+ * @param magazine_size: Number of blocks cached in one magazine,
+ * 0 for DEFAULT_MAGAZINE_SIZE.
+ * @return: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_INVALID_ARGS: Invalid arguments passed.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory for pool.
+ */
+PoolBlockMag *pool_block_mag_create(size_t capacity, size_t block_size,
+        size_t magazine_size);
+
+/**
+ * @brief: Requests memory from the pool.
+ *
+ * @param pool: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory.
+ */
+void *pool_block_mag_alloc(PoolBlockMag *pool);
+
+/**
+ * @brief: Frees previously allocated memory.
+ *
+ * @param pool: Pointer to the memory pool from which the
+ * freed block was allocated.
+ * @param memblock: Pointer to a block of memory allocated
+ * from the pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or memblock pointer is NULL.
+ *          -POOL_INVALID_PTR: memblock is not a block of the pool.
+ */
+void pool_block_mag_free(PoolBlockMag *pool, void *memblock);
+
+/**
+ * @brief: Destroys the pool and frees the memory.
+ *
+ * No other thread may use the pool at this point.
+ *
+ * @param pool: Pointer to the memory pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+void pool_block_mag_destroy(PoolBlockMag *pool);
+
+/**
+ * @brief Returns the number of blocks handed out to the users.
+ *
+ * The value is approximate while other threads use the pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+size_t pool_block_mag_size(PoolBlockMag *pool);
+
+/**
+ * @brief Returns the total size of the pool.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+size_t pool_block_mag_capacity(PoolBlockMag *pool);
+
+#endif // BLOCK_POOL_MAG_H
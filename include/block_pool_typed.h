@@ -0,0 +1,130 @@
+/**
+ * @file: block_pool_typed.h
+ * @brief: Block pools specialized for one type at compile time.
+ *
+ * POOL_BLOCK_DECLARE(name, T, capacity) declares the pool type 'name' and
+ * static inline functions working with pointers to T:
+ *
+ *      name *name_create(void);
+ *      T *name_alloc(name *pool);
+ *      void name_free(name *pool, T *obj);
+ *      bool name_contains(const name *pool, const T *obj);
+ *      void name_clear(name *pool);
+ *      void name_destroy(name *pool);
+ *
+ * The pool is a fixed-size PoolBlock with the header layout. The block size,
+ * the header offset and the capacity are compile-time constants, so the
+ * checks of the hot paths compile to shifts and comparisons and get inlined
+ * into the caller. Only the rare paths (exhausted pool, invalid pointers)
+ * call the generic pool_block_* functions, which also report the errors.
+ *
+ * The inline paths do not log successful operations. The pool stays an
+ * ordinary PoolBlock, so the generic functions may be used on it as well.
+ */
+
+#ifndef BLOCK_POOL_TYPED_H
+#define BLOCK_POOL_TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pool_errors.h>
+#include <block_pool.h>
+
+// Alignment of the blocks of a typed pool.
+#define POOL_TYPED_ALIGNMENT(T) (_Alignof(T) > BLOCK_POOL_ALIGNMENT ? \
+        _Alignof(T) : BLOCK_POOL_ALIGNMENT)
+
+// Size of a block of a typed pool, including the header.
+#define POOL_TYPED_BLOCK_SIZE(T) (MULTIPLE_UP(sizeof(T), POOL_TYPED_ALIGNMENT(T)) + \
+        POOL_TYPED_ALIGNMENT(T))
+
+#define POOL_BLOCK_DECLARE(name, T, capacity) \
+    _Static_assert((capacity) > 0, "pool capacity must not be 0"); \
+    _Static_assert(_Alignof(T) <= BLOCK_POOL_MAX_ALIGNMENT, "type alignment not supported"); \
+    \
+    typedef struct name name; \
+    \
+    static inline name *name##_create(void) \
+    { \
+        return (name *) pool_block_create_aligned((capacity), sizeof(T), \
+                POOL_TYPED_ALIGNMENT(T)); \
+    } \
+    \
+    static inline T *name##_alloc(name *typed) \
+    { \
+        PoolBlock *pool = (PoolBlock *) typed; \
+        BlockSlab *slab = pool->slabs; \
+        uintptr_t *header; \
+        \
+        if (slab->free_list) \
+        { \
+            header = slab->free_list; \
+            slab->free_list = (void *) *header; \
+        } \
+        else if ((byte *) slab->untouched != \
+                (byte *) slab->mem + (capacity) * POOL_TYPED_BLOCK_SIZE(T)) \
+        { \
+            header = slab->untouched; \
+            slab->untouched = (byte *) header + POOL_TYPED_BLOCK_SIZE(T); \
+            if (slab->untouched > slab->zeroed) \
+                slab->zeroed = slab->untouched; \
+        } \
+        else \
+            return pool_block_alloc(pool); \
+        \
+        /* The only slab leaves the list of slabs with free blocks */ \
+        if (++slab->size == (capacity)) \
+            pool->partial = NULL; \
+        ++pool->size; \
+        *header = BLOCK_BUSY; \
+        pool_last_error = POOL_OK; \
+        return (T *) ((byte *) header + POOL_TYPED_ALIGNMENT(T)); \
+    } \
+    \
+    static inline bool name##_contains(const name *typed, const T *obj) \
+    { \
+        const BlockSlab *slab = ((const PoolBlock *) typed)->slabs; \
+        uintptr_t distance = (uintptr_t) obj - \
+            ((uintptr_t) slab->mem + POOL_TYPED_ALIGNMENT(T)); \
+        return distance < (capacity) * POOL_TYPED_BLOCK_SIZE(T) && \
+            distance % POOL_TYPED_BLOCK_SIZE(T) == 0; \
+    } \
+    \
+    static inline void name##_free(name *typed, T *obj) \
+    { \
+        PoolBlock *pool = (PoolBlock *) typed; \
+        BlockSlab *slab = pool->slabs; \
+        \
+        /* The header is found from the slab, a foreign pointer is never offset */ \
+        if (name##_contains(typed, obj)) \
+        { \
+            uintptr_t *header = (uintptr_t *) ((byte *) slab->mem + \
+                ((uintptr_t) obj - (uintptr_t) slab->mem - POOL_TYPED_ALIGNMENT(T))); \
+            if ((void *) header < slab->untouched && *header == BLOCK_BUSY) \
+            { \
+                *header = (uintptr_t) slab->free_list; \
+                slab->free_list = header; \
+                if (slab->size-- == (capacity)) \
+                    pool->partial = slab; \
+                --pool->size; \
+                pool_last_error = POOL_OK; \
+                return; \
+            } \
+        } \
+        \
+        /* The generic function reports the invalid pointers */ \
+        pool_block_free(pool, obj); \
+    } \
+    \
+    static inline void name##_clear(name *typed) \
+    { \
+        pool_block_clear((PoolBlock *) typed); \
+    } \
+    \
+    static inline void name##_destroy(name *typed) \
+    { \
+        pool_block_destroy((PoolBlock *) typed); \
+    }
+
+#endif // BLOCK_POOL_TYPED_H
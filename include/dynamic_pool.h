@@ -3,7 +3,14 @@
  * @brief: Implementing a memory pool with dynamic block size.
  *
  * The canary and other meta-information are placed at the beginning of each block.
+ * Every header links both physical neighbours, so a released block is merged
+ * with the free blocks around it immediately and two free blocks are never
+ * adjacent.
+ * Pools created with POOL_DYN_COMPACT use an 8-byte header instead (see
+ * DynHeader).
  * The minimum memory size allocated is 8 bytes.
+ * The pool memory is aligned to whole pages and registered in the global
+ * pool registry (see pool_registry.h).
  */
 
 #ifndef DYNAMIC_POOL
@@ -11,13 +18,15 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pool_pages.h>
 
 // The ftirst canary of the block
 #define CANARY_FREE 0xFFFEC0DE
 #define CANARY_USED 0xFFFFC0DE
 
 // The second canary of the block
-#define END_CANARY 0xC0DE5005E695005E
+#define END_CANARY 0xC0DE5005
 
 // Macros for alignment to the nearest multiple
 #define MULTIPLICITY_UP(value, multiple) (((value) + (multiple - 1)) & ~((multiple) - 1))
@@ -25,7 +34,7 @@
 
 /**
  * Used to increase allocated memory to compensate
- * for metadata
+ * for metadata in the pools that cannot grow
  */
 #define ADVANCE 1.3
 
@@ -35,31 +44,157 @@
  */
 #define MIN_ALLOC_SIZE 8
 
-// Used to align the pool address. It is forbidden to change this value.
+// Default alignment of the blocks. It is forbidden to change this value.
 #define ALIGNMENT 8
 
+// Largest supported block alignment: the pool memory is aligned to pages.
+#define DYN_MAX_ALIGNMENT 4096
+
+// Flags of PoolDynOptions
+#define POOL_DYN_TLSF 0x1       // Free blocks are indexed by size (bounded-time allocation)
+#define POOL_DYN_COMPACT 0x2    // 8-byte block headers without canaries
+#define POOL_DYN_HUGE_PAGES 0x4 // The pool memory is backed by huge pages
+
+/* Integrity checks of the block headers */
+typedef enum {
+    POOL_DYN_INTEGRITY_DEFAULT = 0, // POOL_DYN_DEFAULT_INTEGRITY.
+    POOL_DYN_INTEGRITY_NONE,        // No checks, the canary is only the busy flag.
+    POOL_DYN_INTEGRITY_CANARY,      // The canaries tell damaged headers.
+    POOL_DYN_INTEGRITY_CHECKSUM,    // A CRC32C of the header replaces the end canary.
+} PoolDynIntegrity;
+
+/* How the pool grows when no arena has a suitable free block */
+typedef enum {
+    POOL_DYN_GROW_NONE = 0, // The pool has a fixed capacity.
+    POOL_DYN_GROW_DOUBLE,   // Each new arena doubles the pool capacity.
+    POOL_DYN_GROW_FIXED,    // Each new arena adds growth_step bytes.
+} PoolDynGrowth;
+
+// Integrity level of the pools created without one
+#ifndef POOL_DYN_DEFAULT_INTEGRITY
+#define POOL_DYN_DEFAULT_INTEGRITY POOL_DYN_INTEGRITY_CANARY
+#endif
+
+/**
+ * Two-level segregated fit index: the first level splits the block sizes
+ * by powers of 2, the second level splits each power into
+ * DYN_TLSF_SL_COUNT ranges of equal width.
+ */
+#define DYN_TLSF_SL_BITS 4
+#define DYN_TLSF_SL_COUNT (1 << DYN_TLSF_SL_BITS)
+#define DYN_TLSF_FL_COUNT 64
+
 /**
- * Represents Meta information about a block
+ * The smallest block of a pool with the index. A free block keeps the
+ * links of its free list in the payload.
+ */
+#define DYN_TLSF_MIN_SIZE 16
+
+/**
+ * Represents Meta information about a block.
+ * All fields are naturally aligned, the canaries end the header right in
+ * front of the payload.
  */
-# pragma pack(push, 1)              // Set alignment to 1
 typedef struct meta_data {
-    uint32_t canary;                // Serves as a block busy flag and metadata integrity flag
-    unsigned int size;              // Block size
+    size_t size;                    // Block size
     struct meta_data *next_block;   // Points to the next block
-    uint64_t end_canary;            // Necessary for correct recognition of block metadata signatyre
+    struct meta_data *prev_block;   // Points to the previous block
+    uint32_t canary;                // Serves as a block busy flag and metadata integrity flag
+    uint32_t end_canary;            // Necessary for correct recognition of block metadata signatyre
 }MetaData;
-# pragma pack(pop)
 
 /**
- * Memory pool structure
+ * Header of a block in a pool with POOL_DYN_COMPACT: the block size with
+ * the state in the low bits (block sizes are multiples of 8). The next
+ * block starts right behind the payload. A free block repeats its size in
+ * the last 8 bytes of the payload, so a released block finds the free
+ * block in front of it.
+ */
+typedef uint64_t DynHeader;
+
+#define DYN_BLOCK_FREE 0x1                  // The block is free
+#define DYN_PREV_FREE 0x2                   // The block in front of it is free
+#define DYN_SIZE_MASK (~(DynHeader) 0x7)
+
+/**
+ * Index of the free blocks: a doubly linked list per size range and
+ * bitmaps of the non-empty lists, so a suitable block is found with two
+ * bit scans.
+ */
+typedef struct dyn_tlsf {
+    uint64_t fl_bitmap;                     // Non-empty first level ranges
+    uint32_t sl_bitmap[DYN_TLSF_FL_COUNT];  // Non-empty lists of each range
+    void *heads[DYN_TLSF_FL_COUNT][DYN_TLSF_SL_COUNT];  // Free lists (block headers)
+} DynTlsf;
+
+// Number of size buckets of the free block histogram
+#define DYN_STATS_BUCKETS 64
+
+/* Free blocks of a pool */
+typedef struct pool_dyn_stats {
+    size_t free_blocks;     // Number of free blocks.
+    size_t free_bytes;      // Total payload of the free blocks (in bytes).
+    size_t largest_free;    // Payload of the largest free block (in bytes).
+    size_t histogram[DYN_STATS_BUCKETS];    // Number of free blocks with
+                                            // a payload in [2^i, 2^(i+1)).
+} PoolDynStats;
+
+/**
+ * Memory pool structure.
+ * A growable pool is a chain of arenas, each of them is a PoolDyn with its
+ * own memory, blocks and index. The pool handle is the first arena, the
+ * fields below describe this arena only unless noted otherwise.
  */
 typedef struct pool_dyn {
     void *raw;           // Start of unaligned pool
-    void *mem_pool;     // Start of aligned pool
+    void *mem_pool;     // Start of aligned pool (the first block header)
     size_t capacity;    // Total size of the memory pool (in bytes)
     size_t size;        // Amount of allocated memory (in bytes)
+    size_t alignment;   // Alignment of the blocks
+    DynTlsf *tlsf;      // Index of the free blocks, NULL for the first fit
+    void *zeroed;       // The pool memory from here on was never written
+    unsigned int flags;     // POOL_DYN_* flags the pool was created with
+    size_t header_size;     // Size of a block header
+    size_t min_block;       // Smallest payload of a block
+    PoolDynIntegrity integrity; // Checks of the block headers
+    PoolPagesKind pages;        // Pages backing the pool memory
+    struct pool_dyn *pool;          // Pool the arena belongs to (itself for
+                                    // the first arena)
+    struct pool_dyn *next_arena;    // Next arena of the pool
+    struct pool_dyn *empty;         // Completely free arena kept to avoid
+                                    // thrashing on the growth boundary
+    PoolDynGrowth growth;           // Growth policy (first arena only)
+    size_t growth_step;             // Arena capacity for POOL_DYN_GROW_FIXED
+    size_t trim_threshold;          // Size of a free block to trim it at
+    void *coalesce_cursor;          // Block the next coalescing step starts
+                                    // from, NULL for the first one
+    struct pool_dyn *coalesce_arena;    // Arena the next coalescing step
+                                        // starts in (first arena only)
+    PoolDynStats stats;     // Free blocks of the arena, largest_free is an
+                            // upper bound unless largest_exact is set
+    size_t largest_count;   // Number of free blocks of the exact largest size
+    bool largest_exact;     // largest_free is the exact size
 } PoolDyn;
 
+/* Additional pool creation parameters */
+typedef struct pool_dyn_options {
+    unsigned int flags;     // Combination of POOL_DYN_* flags.
+    size_t alignment;       // Alignment of the blocks (power of 2),
+                            // 0 for ALIGNMENT.
+    PoolDynIntegrity integrity; // Checks of the block headers.
+    PoolDynGrowth growth;   // Growth policy.
+    size_t growth_step;     // Arena capacity for POOL_DYN_GROW_FIXED (in bytes).
+    size_t trim_threshold;  // A released block merged into a free block of at
+                            // least this size is trimmed (see pool_dyn_trim),
+                            // 0 to never trim.
+} PoolDynOptions;
+
+/* Limits of one pool_dyn_coalesce_step, 0 for no limit */
+typedef struct pool_dyn_budget {
+    size_t blocks;  // Number of blocks visited.
+    uint64_t ns;    // Time spent (in nanoseconds).
+} PoolDynBudget;
+
 /**
  * @brief Creates a dynamic memory pool.
  *
@@ -73,6 +208,74 @@ typedef struct pool_dyn {
  */
 PoolDyn *pool_dyn_create(size_t capacity);
 
+/**
+ * @brief Creates a dynamic memory pool with aligned blocks.
+ *
+ * Every block header is placed right in front of an aligned address, the
+ * padding this needs is added to the end of the previous block.
+ *
+ * @param capacity Size of the memory pool (in bytes).
+ * @param alignment Alignment of the blocks, a power of 2 between ALIGNMENT
+ * and DYN_MAX_ALIGNMENT.
+ * @return Pointer tot the structure of the created memory pool,
+ * or NULL if an error occurred.
+ *
+ * @errors:
+ *      -POOL_OK: Function worked without errors.
+ *      -POOL_INVALID_ARGS: Invalid alignment passed.
+ *      -POOL_ALLOC_FAILED: Failed to allocate memory for pool.
+ */
+PoolDyn *pool_dyn_create_aligned(size_t capacity, size_t alignment);
+
+/**
+ * @brief Creates a dynamic memory pool with additional parameters.
+ *
+ * By default a free block is searched for by the first fit over all
+ * blocks of the pool. With POOL_DYN_TLSF the free blocks are indexed by
+ * size (two-level segregated fit), so allocation and release take bounded
+ * time independent of the number of blocks.
+ *
+ * With POOL_DYN_COMPACT a block carries an 8-byte DynHeader instead of
+ * MetaData. The header has no canaries: damaged headers are not detected
+ * and restore_block has nothing to do.
+ *
+ * With POOL_DYN_HUGE_PAGES the pool memory is mapped with huge pages
+ * where the system has them (see pool_pages_alloc_huge), which saves
+ * TLB misses in pools of many GiB. The mapping is rounded up to whole
+ * huge pages.
+ *
+ * The integrity level decides how damaged MetaData headers are detected.
+ * POOL_DYN_INTEGRITY_NONE skips all checks (and restore_block does
+ * nothing), POOL_DYN_INTEGRITY_CANARY compares the canaries, and
+ * POOL_DYN_INTEGRITY_CHECKSUM keeps a CRC32C of the header in place of
+ * the end canary (computed by the processor where it supports SSE 4.2
+ * or the ARM CRC32 extension, detected at run time, and with a lookup
+ * table otherwise), so any damaged header field is detected.
+ *
+ * A pool that cannot grow gets ADVANCE times the requested capacity to
+ * hold the block headers. A growable pool is sized exactly: its first
+ * arena takes the requested capacity (and the rest of its last page).
+ * When no arena has a suitable free block, a new arena is added: it
+ * doubles the pool capacity (POOL_DYN_GROW_DOUBLE) or adds growth_step
+ * bytes (POOL_DYN_GROW_FIXED), and is made larger if the request needs
+ * it. Each arena is registered in the pool registry, so pool_dyn_free
+ * finds the arena of a block in constant time. The added arenas that
+ * become completely free are released, except for one.
+ *
+ * @param capacity Size of the memory pool (in bytes).
+ * @param options Creation parameters, NULL for the defaults.
+ * @return Pointer tot the structure of the created memory pool,
+ * or NULL if an error occurred.
+ *
+ * @errors:
+ *      -POOL_OK: Function worked without errors.
+ *      -POOL_INVALID_ARGS: Invalid alignment, integrity level or growth
+ *      policy passed (compact pools only have POOL_DYN_INTEGRITY_NONE,
+ *      POOL_DYN_GROW_FIXED needs a growth step).
+ *      -POOL_ALLOC_FAILED: Failed to allocate memory for pool.
+ */
+PoolDyn *pool_dyn_create_ex(size_t capacity, const PoolDynOptions *options);
+
 /**
  *  @brief Allocates the requested amount of memory from the pool.
  *
@@ -89,11 +292,53 @@ PoolDyn *pool_dyn_create(size_t capacity);
  */
 void *pool_dyn_alloc(PoolDyn *pool, size_t size);
 
+/**
+ * @brief Allocates memory aligned to the given alignment.
+ *
+ * The free space in front of the aligned address becomes a free block of
+ * its own, which is reused by later allocations. The memory is released
+ * by pool_dyn_free as usual.
+ *
+ * @param pool Pointer to the memory pool.
+ * @param size Amount of memory required.
+ * @param alignment Alignment of the memory, a power of 2 up to DYN_MAX_ALIGNMENT.
+ * @return Pointer to the beginning of the allocated memory,
+ * NULL if an error occurred.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: Pool pointer is NULL.
+ *          -POOL_INVALID_ARGS: Invalid alignment passed.
+ *          -POOL_ALLOC_FAILED: Failed to allocate the requested amount memory.
+ *          -POOL_BLOCK_DAMAGED: One of the blocks is damaged.
+ */
+void *pool_dyn_alloc_aligned(PoolDyn *pool, size_t size, size_t alignment);
+
+/**
+ * @brief Allocates zero-filled memory from the pool.
+ *
+ * The pool memory comes zero-filled from the system and the pool keeps
+ * a high-water mark of the memory it ever handed out or wrote metadata
+ * to. Only the part of the block below the mark is cleared.
+ *
+ * @param pool Pointer to the memory pool.
+ * @param size Amount of memory required.
+ * @return Pointer to the beginning of the zero-filled memory,
+ * NULL if an error occurred.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: Pool pointer is NULL.
+ *          -POOL_ALLOC_FAILED: Failed to allocate the requested amount memory.
+ *          -POOL_BLOCK_DAMAGED: One of the blocks is damaged.
+ */
+void *pool_dyn_calloc(PoolDyn *pool, size_t size);
+
 /**
  * @brief pool_alloc function wrapper.
  *
- * If the allocation fails the function may attempt 
- * to merge free blocks and retry the allocation.
+ * Kept for compatibility: free blocks are merged as soon as they are
+ * released, so there is nothing left to merge when the allocation fails.
  *
  *  @param pool Pointer to the memory pool.
  *  @param size Amount of memory required.
@@ -109,6 +354,29 @@ void *pool_dyn_alloc(PoolDyn *pool, size_t size);
 void *pool_dyn_alloc_safe(PoolDyn *pool, size_t size);
 
 
+/**
+ * @brief Changes the size of previously allocated memory.
+ *
+ * The block grows in place if the block behind it is free and large
+ * enough, and shrinks in place by returning its tail to the pool. Only
+ * otherwise the contents are moved to a new block, which has the alignment
+ * of the pool (not the one passed to pool_dyn_alloc_aligned).
+ *
+ * @param pool Pointer to the pool from which the memory was allocated.
+ * @param block Pointer to the memory, NULL to allocate new memory.
+ * @param size New amount of memory, 0 to free the memory.
+ * @return Pointer to the memory, NULL if an error occurred (the memory is
+ * left unchanged) or the memory was freed.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ *          -POOL_INVALID_PTR: block pointer is not an allocated block of the pool.
+ *          -POOL_ALLOC_FAILED: Failed to allocate the requested amount memory.
+ *          -POOL_BLOCK_DAMAGED: One of the blocks is damaged.
+ */
+void *pool_dyn_realloc(PoolDyn *pool, void *block, size_t size);
+
 /**
  * @brief Frees previously allocated memory.
  *
@@ -118,7 +386,8 @@ void *pool_dyn_alloc_safe(PoolDyn *pool, size_t size);
  * @errors:
  *          -POOL_OK: Function worked without errors.
  *          -POOL_NULL_PTR: pool or block pointer is NULL.
- *          -POOL_INVALID_PTR: block pointer is not in the pool or is not aligned.
+ *          -POOL_INVALID_PTR: block pointer is not in the pool or is not aligned,
+ *          or the block is already free (POOL_DYN_TLSF).
  *          -POOL_BLOCK_DAMAGED: One of the blocks is damaged.
  */
 void pool_dyn_free(PoolDyn *pool, void *block);
@@ -127,7 +396,8 @@ void pool_dyn_free(PoolDyn *pool, void *block);
  * @brief Clears the pool.
  *
  * After using this function, pointers to all previously allocated
- * memory will become dangling.
+ * memory will become dangling. A growable pool releases all its arenas
+ * but the first one.
  *
  * @param pool Pointer to the pool to be cleared.
  *
@@ -151,7 +421,27 @@ void pool_dyn_clear(PoolDyn *pool);
 void pool_dyn_destroy(PoolDyn *pool);
 
 /**
- * @brief Returns the current size of the pool's occupied space.
+ * @brief Gives the pages inside the free blocks back to the system.
+ *
+ * Only the whole pages between the links a free block keeps at the start
+ * of its payload and the end of the block are released (all arenas), the
+ * pool is not changed otherwise. The pages are committed again,
+ * zero-filled, when the memory is reused.
+ *
+ * A pool created with a trim_threshold trims every free block of at least
+ * that size as soon as it is formed by pool_dyn_free or pool_dyn_realloc.
+ *
+ * @param pool Pointer to the pool.
+ * @return Number of bytes released.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+size_t pool_dyn_trim(PoolDyn *pool);
+
+/**
+ * @brief Returns the current size of the pool's occupied space (all arenas).
  * @param pool Pointer to the pool.
  * @return Size of occupied space.
  *
@@ -162,7 +452,7 @@ void pool_dyn_destroy(PoolDyn *pool);
 size_t pool_dyn_size(PoolDyn *pool);
 
 /**
- * @brief Returns the total size of the pool.
+ * @brief Returns the total size of the pool (all arenas).
  * @param pool Pointer to the pool.
  * @return Pool capacity.
  *
@@ -174,6 +464,11 @@ size_t pool_dyn_capacity(PoolDyn *pool);
 
 /**
  * @brief Eliminates pool fragmentation by merging free blocks.
+ *
+ * pool_dyn_free already merges the released block with its free
+ * neighbours. Only free blocks left unmerged because of damaged metadata
+ * need this pass.
+ *
  * @param pool Pointer to the pool.
  *
  * @errors:
@@ -182,6 +477,48 @@ size_t pool_dyn_capacity(PoolDyn *pool);
  */
 void coalesce_free_blocks(PoolDyn *pool);
 
+/**
+ * @brief Returns the statistics of the free blocks.
+ *
+ * The counters are kept up to date by every allocation, release and merge,
+ * so reading them costs a constant time per arena. The largest size stays
+ * exact when the largest block is split, or when a block of its size or of
+ * a higher power of two remains. Only when the last such block was taken
+ * whole (or the remainder shares its power of two with other free blocks),
+ * the next largest block is searched for: in the highest non-empty list of
+ * the index, or over all the blocks of a first fit pool. Free blocks with
+ * damaged metadata may be counted until coalesce_free_blocks recounts them.
+ *
+ * @param pool Pointer to the pool.
+ * @param stats Receives the statistics of all arenas.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool or stats pointer is NULL.
+ */
+void pool_dyn_stats(PoolDyn *pool, PoolDynStats *stats);
+
+/**
+ * @brief Merges free blocks incrementally, within a budget.
+ *
+ * Does the work of coalesce_free_blocks in steps: every call continues
+ * the pass over the blocks (of all arenas) where the previous one stopped,
+ * and stops when the number of visited blocks or the time reaches the
+ * budget. Each visit merges at most one pair of blocks. The time is
+ * checked every few blocks, so a step may run over it by a few visits.
+ * The pool may be used freely between the steps.
+ *
+ * @param pool Pointer to the pool.
+ * @param budget Limits of the step, NULL to finish the pass.
+ * @return 'true' if the pass is finished (the next step starts a new one)
+ * or an error occurred, 'false' if the budget ran out.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pool pointer is NULL.
+ */
+bool pool_dyn_coalesce_step(PoolDyn *pool, const PoolDynBudget *budget);
+
 /**
  * @brief Restoring damaged blocks
  * @param pool Pointer to the pool
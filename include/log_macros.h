@@ -1,6 +1,9 @@
 /**
  * @file log_macros.h
  * @brief Macros for error logging
+ *
+ * A message is formatted only if its level is enabled for at least one
+ * destination, so disabled logging costs a single check.
  */
 #ifndef LOG_MACROS_H
 #define LOG_MACROS_H
@@ -9,6 +12,7 @@
 
 // Macro for logging pool creation error
 #define LOG_POOL_CREATE_ERROR(size) do {\
+    if (!logLevelEnabled(LOG_LEVEL_ERROR)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[ERROR] Pool was not created, the system cannot allocate enough memory: %lu byte\n", (size));\
     logging(logger_buffer, LOG_LEVEL_ERROR); }\
@@ -16,6 +20,7 @@
 
 // Macro for logging message about invalid arguments
 #define LOG_POOL_INVALID_ARGS do {\
+    if (!logLevelEnabled(LOG_LEVEL_ERROR)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[ERROR] Invalid parameters passed.\nFunc: %s\n", __func__);\
     logging(logger_buffer, LOG_LEVEL_ERROR); }\
@@ -23,6 +28,7 @@
 
 // Macro for logging block allocation error (Not enough free space)
 #define LOG_POOL_NOT_FREE_SPACE(pool, free_memory, memory_required) do {\
+    if (!logLevelEnabled(LOG_LEVEL_ERROR)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[ERROR] Allocation failed, there is not enough free memory in the pool.\n"\
             "Pool: %p | Amount of free memory: %lu | Memory required: %lu\n",\
@@ -32,6 +38,7 @@
 
 // Macro for logging block allocation error (the pool is highly fragmented)
 #define LOG_POOL_FRAGMENTED(pool, memory_required) do {\
+    if (!logLevelEnabled(LOG_LEVEL_ERROR)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[ERROR] Allocation failed, the pool is highly fragmented.\nPool %p | Memory required: %lu\n",\
             (pool), (memory_required));\
@@ -40,6 +47,7 @@
 
 // Macro for logging optimization error message
 #define LOG_POOL_OPTIMIZE_ERROR(pool) do {\
+    if (!logLevelEnabled(LOG_LEVEL_ERROR)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[ERROR] Error trying to optimize pool.\nPool: %p\n", (pool));\
     logging(logger_buffer, LOG_LEVEL_ERROR); }\
@@ -47,6 +55,7 @@
 
 // Macro for logging block recovery error message
 #define LOG_BLOCK_RECOVERY_FAILED(pool, block) do {\
+    if (!logLevelEnabled(LOG_LEVEL_ERROR)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[ERROR] Failed to restore block.\nPool: %p | Block %p\n", (pool), (block));\
     logging(logger_buffer, LOG_LEVEL_ERROR); }\
@@ -56,6 +65,7 @@
 
 // Macro for logging NULL pointer error
 #define LOG_POOL_NULL_PTR do {\
+    if (!logLevelEnabled(LOG_LEVEL_WARN)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[WARN] NULL pointer was passed.\nFunc: %s\n", __func__);\
     logging(logger_buffer, LOG_LEVEL_WARN); }\
@@ -63,6 +73,7 @@
 
 // Macro for logging pointer error (this pointer does not belong to the pool)
 #define LOG_POOL_ALIEN_PTR(ptr) do {\
+    if (!logLevelEnabled(LOG_LEVEL_WARN)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[WARN] Someone else's pointer was passed.\nFunc: %s | Pointer %p\n", __func__, (ptr));\
     logging(logger_buffer, LOG_LEVEL_WARN); }\
@@ -70,6 +81,7 @@
 
 // Macro for logging pointer alignment error
 #define LOG_POOL_PTR_NOT_ALIGNMENT(ptr) do {\
+    if (!logLevelEnabled(LOG_LEVEL_WARN)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[WARN] The passed pointer is not aligned.\nFunc: %s | Pointer: %p\n", __func__, (ptr));\
     logging(logger_buffer, LOG_LEVEL_WARN); }\
@@ -77,6 +89,7 @@
 
 // Macro for logging invalid pointer message (pointer is not the start of a block)
 #define LOG_POOL_INVALID_PTR(ptr) do {\
+    if (!logLevelEnabled(LOG_LEVEL_WARN)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[WARN] The passed pointer is not the start of a block.\nFunc: %s | Pointer: %p\n",\
              __func__, (ptr));\
@@ -85,6 +98,7 @@
 
 // Macro for logging a message about a damaged block
 #define LOG_BLOCK_DAMAGED(pool, block) do {\
+    if (!logLevelEnabled(LOG_LEVEL_WARN)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[WARN] Block is damaged.\nPool: %p | Block %p\n", (pool), (block));\
     logging(logger_buffer, LOG_LEVEL_WARN); }\
@@ -94,6 +108,7 @@
 
 // Macro for logging optimizarion failed message
 #define LOG_POOL_OPTIMIZE_FAILED(pool) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Pool optimization failed (no result). Pool: %p\n", (pool));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -101,6 +116,7 @@
 
 // Macro for logging optimization successful message
 #define LOG_POOL_OPTIMIZE_SUCCESSFUL(pool) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Pool optimization was successful (several blocks ware merged).\nPool: %p\n", (pool));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -108,6 +124,7 @@
 
 // Macro for logging block recovery attempt
 #define LOG_RESTORE_BLOCK(block) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Attempt to restore block.\nBlock: %p\n", (block));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -115,6 +132,7 @@
 
 // Macro for logging a message about successful block recovery
 #define LOG_BLOCK_SUCCESSFUL_RECOVERY(block) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Block successfully restored.\nBlock: %p\n", (block));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -122,6 +140,7 @@
 
 // Macro for logging pool optimization attempt (partial fragmentation eliminator)
 #define LOG_POOL_OPTIMIZATION_ATTEMPT(pool) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Trying to optimize pool.\nPool: %p\n", (pool));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -129,6 +148,7 @@
 
 // Macro for logging pool creation information
 #define LOG_POOL_CREATE_INFO(capacity, min_block_size, start_address) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Pool has been created.\nCapacity: %lu | Min block size: %d | Start address: %p\n",\
             (capacity), (min_block_size), (start_address));\
@@ -137,6 +157,7 @@
 
 // Macro for logging message about pool cleanup
 #define LOG_POOL_CLEANUP(pool, pool_capacity) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Pool cleanup.\nPool: %p | Capacity: %lu\n", (pool), (pool_capacity));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -144,6 +165,7 @@
 
 // Macro for logging message about pool destruction
 #define LOG_POOL_DESTROYED(pool) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Pool was destroyed.\nPool: %p\n", (pool));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
@@ -153,16 +175,34 @@
 
 // Macro for logging block allocation message
 #define LOG_BLOCK_ALLOCATION(pool, block, block_size) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Allocated block: %p | Pool: %p | Block size: %lu\n", (block), (pool), (block_size));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
     while (0)
 
+// Macro for logging allocation of several blocks at once
+#define LOG_BLOCK_BATCH_ALLOCATION(pool, count, block_size) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
+    snprintf(logger_buffer, sizeof(logger_buffer),\
+            "[INFO] Allocated blocks: %lu | Pool: %p | Block size: %lu\n", (count), (pool), (block_size));\
+    logging(logger_buffer, LOG_LEVEL_INFO); }\
+    while (0)
+
 // Macro for logging message about block release
 #define LOG_BLOCK_FREE(pool, block, block_size) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
     snprintf(logger_buffer, sizeof(logger_buffer),\
             "[INFO] Released block: %p | Pool: %p | Block size: %lu\n", (block), (pool), (block_size));\
     logging(logger_buffer, LOG_LEVEL_INFO); }\
     while (0)
 
+// Macro for logging release of several blocks at once
+#define LOG_BLOCK_BATCH_FREE(pool, count, block_size) do {\
+    if (!logLevelEnabled(LOG_LEVEL_INFO)) break;\
+    snprintf(logger_buffer, sizeof(logger_buffer),\
+            "[INFO] Released blocks: %lu | Pool: %p | Block size: %lu\n", (count), (pool), (block_size));\
+    logging(logger_buffer, LOG_LEVEL_INFO); }\
+    while (0)
+
 #endif // LOG_MACROS_H
@@ -0,0 +1,130 @@
+/**
+ * @file: pool_alloc.h
+ * @brief: General-purpose allocator built from block pools.
+ *
+ * Small requests are routed to one of the size classes, each of them a
+ * growable block pool with the busy flags stored in a bitmap (the blocks
+ * carry no header). The classes go from 8 to 4096 bytes, every power of
+ * two is followed by an intermediate step of 1.5 times the power, so at
+ * most a third of a block is wasted. Larger requests are served by a
+ * dynamic pool.
+ *
+ * The pools of the size classes are created on first use and share the
+ * memory released by their empty slabs, instead of every subsystem
+ * keeping its own partially used pool.
+ *
+ * The owner of a pointer is found in the global pool registry, so the
+ * memory of any block or dynamic pool can be freed with pool_free_any()
+ * without knowing the pool.
+ */
+
+#ifndef POOL_ALLOC_H
+#define POOL_ALLOC_H
+
+#include <stddef.h>
+#include <block_pool.h>
+#include <dynamic_pool.h>
+
+// Smallest and largest size classes (bytes).
+#define SIZE_CLASS_MIN 8
+#define SIZE_CLASS_MAX 4096
+
+// Number of size classes: 8, 16, 24, 32, 48, 64, ..., 3072, 4096.
+#define SIZE_CLASS_COUNT 18
+
+// Size of the first slab of a size class if no value is specified.
+#define DEFAULT_CLASS_SLAB_SIZE (16 * 1024)
+
+/* Allocator with size classes */
+typedef struct pool_alloc {
+    PoolBlock *classes[SIZE_CLASS_COUNT];   // Size classes, NULL until first use.
+    PoolDyn *large;         // Pool for the requests above SIZE_CLASS_MAX.
+    size_t slab_size;       // Size of the first slab of a size class (bytes).
+} PoolAlloc;
+
+/**
+ * @brief: Creates an allocator.
+ *
+ * @param slab_size: Size of the first slab of every size class in bytes,
+ * 0 for DEFAULT_CLASS_SLAB_SIZE. The classes grow by doubling.
+ * @param large_capacity: Capacity of the first arena of the dynamic pool
+ * serving the requests above SIZE_CLASS_MAX, 0 if such requests are not
+ * needed. The dynamic pool grows by doubling.
+ * @return: Pointer to the allocator.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory for the allocator.
+ *          -POOL_CREATE_FAILED: Failed to create the dynamic pool.
+ */
+PoolAlloc *pool_alloc_create(size_t slab_size, size_t large_capacity);
+
+/**
+ * @brief: Requests memory from the allocator.
+ *
+ * @param pa: Pointer to the allocator.
+ * @param size: Amount of memory required.
+ * @return: Pointer to the allocated memory, NULL if an error occurred.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pa pointer is NULL.
+ *          -POOL_ALLOC_FAILED: Failed to allocate memory.
+ */
+void *pool_malloc(PoolAlloc *pa, size_t size);
+
+/**
+ * @brief: Frees memory previously allocated by pool_malloc.
+ *
+ * @param pa: Pointer to the allocator.
+ * @param ptr: Pointer to the memory to be freed.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pa or ptr pointer is NULL.
+ *          -POOL_INVALID_PTR: ptr was not allocated by the allocator.
+ */
+void pool_free(PoolAlloc *pa, void *ptr);
+
+/**
+ * @brief: Frees memory of any block pool or dynamic pool.
+ *
+ * The owning pool is found in the pool registry in constant time. Blocks
+ * of the thread-safe block pools must be freed through their own pools.
+ *
+ * @param ptr: Pointer to the memory to be freed.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: ptr pointer is NULL.
+ *          -POOL_INVALID_PTR: ptr does not belong to any pool or is not
+ *          an allocated block.
+ */
+void pool_free_any(void *ptr);
+
+/**
+ * @brief: Destroys the allocator and all of its pools.
+ *
+ * @param pa: Pointer to the allocator.
+ *
+ * @errors:
+ *          -POOL_OK: Function worked without errors.
+ *          -POOL_NULL_PTR: pa pointer is NULL.
+ */
+void pool_alloc_destroy(PoolAlloc *pa);
+
+/**
+ * @brief: Returns the index of the size class serving the given size.
+ *
+ * @param size: Amount of memory required, at most SIZE_CLASS_MAX.
+ */
+size_t pool_size_class(size_t size);
+
+/**
+ * @brief: Returns the block size of the size class.
+ *
+ * @param index: Index of the size class.
+ */
+size_t pool_size_class_size(size_t index);
+
+#endif // POOL_ALLOC_H
@@ -17,7 +17,8 @@ typedef enum {
     POOL_BLOCK_DAMAGED, // One of the blocks is damaged
 } PoolError;
 
-extern PoolError pool_last_error;
+// The last error is tracked separately for each thread
+extern _Thread_local PoolError pool_last_error;
 
 extern char *str_errors[];
 
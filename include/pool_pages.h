@@ -0,0 +1,81 @@
+/**
+ * @file: pool_pages.h
+ * @brief: Page-granular memory for the pool buffers.
+ *
+ * The buffers are anonymous private mappings. The kernel backs them with
+ * zero pages that are committed on first write, so a fresh buffer is
+ * known to be zero without clearing it, and its untouched part costs no
+ * physical memory. The pages of the free parts can be given back to the
+ * system (pool_pages_release), they are committed again on the next write.
+ */
+
+#ifndef POOL_PAGES_H
+#define POOL_PAGES_H
+
+#include <stddef.h>
+
+// Size of a huge page (the default one of x86-64 and AArch64).
+#define POOL_PAGES_HUGE_SIZE ((size_t) 2 << 20)
+
+/* Pages backing a mapping */
+typedef enum {
+    POOL_PAGES_BASE = 0,    // Base pages of the system.
+    POOL_PAGES_HUGETLB,     // Huge pages reserved by the system (MAP_HUGETLB).
+    POOL_PAGES_THP,         // Transparent huge pages requested by madvise.
+} PoolPagesKind;
+
+/**
+ * @brief: Maps zero-filled memory.
+ *
+ * @param size: Size of the memory, a multiple of REGISTRY_PAGE_SIZE.
+ * @return: Page-aligned pointer to the memory, NULL if it could not be mapped.
+ */
+void *pool_pages_alloc(size_t size);
+
+/**
+ * @brief: Maps zero-filled memory backed by huge pages if possible.
+ *
+ * The reserved huge pages are tried first. Without them the memory is
+ * aligned to a huge page and the kernel is asked to back it with
+ * transparent huge pages. If that is disabled too, the memory stays on
+ * base pages.
+ *
+ * @param size: Size of the memory, a multiple of POOL_PAGES_HUGE_SIZE.
+ * @param kind: Receives the pages backing the memory, may be NULL.
+ * @return: Pointer to the memory aligned to POOL_PAGES_HUGE_SIZE, NULL if
+ * it could not be mapped.
+ */
+void *pool_pages_alloc_huge(size_t size, PoolPagesKind *kind);
+
+/**
+ * Released pages are freed lazily (MADV_FREE): the system reclaims them
+ * only under memory pressure, until then they stay counted in the RSS.
+ * By default they are freed right away (MADV_DONTNEED).
+ */
+#ifndef POOL_PAGES_LAZY_FREE
+#define POOL_PAGES_LAZY_FREE 0
+#endif
+
+/**
+ * @brief: Gives the whole pages between two addresses back to the system.
+ *
+ * The mapping stays valid: the next access to a page commits a new one,
+ * filled with zeros (or, with POOL_PAGES_LAZY_FREE, the old contents if
+ * the page was not reclaimed yet). Reserved huge pages are released whole.
+ *
+ * @param start: Start of the range, rounded up to a page.
+ * @param end: End of the range, rounded down to a page.
+ * @param kind: Pages backing the mapping.
+ * @return: Number of bytes released.
+ */
+size_t pool_pages_release(void *start, void *end, PoolPagesKind kind);
+
+/**
+ * @brief: Unmaps memory returned by pool_pages_alloc or pool_pages_alloc_huge.
+ *
+ * @param pages: Pointer returned by the allocation.
+ * @param size: Size passed to the allocation.
+ */
+void pool_pages_free(void *pages, size_t size);
+
+#endif // POOL_PAGES_H
@@ -0,0 +1,70 @@
+/**
+ * @file: pool_registry.h
+ * @brief: Global map from memory addresses to the pools owning them.
+ *
+ * The address space is divided into pages of REGISTRY_PAGE_SIZE bytes.
+ * A three-level radix tree keyed by the page number stores the owner of
+ * every registered page, so the owner of any pointer is found with at most
+ * five loads, however many pools exist. A range covering the whole span of
+ * an inner slot (16 MiB or 64 GiB) stores its owner in the slot itself, so
+ * registering a large mapping costs about one store per span rather than
+ * per page. The nodes of the tree are created on first use and never
+ * released.
+ *
+ * A page belongs to one owner at most, so the registered ranges must
+ * start on a page boundary and must not share pages. The buffers of the
+ * block pool slabs and of the dynamic pools are allocated that way.
+ *
+ * Registration and lookup may be called from different threads.
+ */
+
+#ifndef POOL_REGISTRY_H
+#define POOL_REGISTRY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Granularity of the registry. This value must be STRICTLY a power of 2.
+#define REGISTRY_PAGE_SHIFT 12
+#define REGISTRY_PAGE_SIZE ((size_t) 1 << REGISTRY_PAGE_SHIFT)
+
+// Number of address bits covered by the registry.
+#define REGISTRY_ADDRESS_BITS 48
+
+/* Type of the registered owner */
+typedef enum {
+    POOL_KIND_NONE = 0, // The address is not registered.
+    POOL_KIND_BLOCK,    // The owner is a slab of a block pool (BlockSlab).
+    POOL_KIND_DYN,      // The owner is a dynamic pool (PoolDyn).
+} PoolKind;
+
+/**
+ * @brief: Registers the owner of a memory range.
+ *
+ * @param start: Start of the range, aligned to REGISTRY_PAGE_SIZE.
+ * @param size: Size of the range in bytes.
+ * @param owner: Owner of the range, aligned to at least 4 bytes.
+ * @param kind: Type of the owner.
+ * @return: 'true' if the range was registered, 'false' if the tree
+ * could not be extended or the range is outside of the covered addresses.
+ */
+bool pool_registry_add(const void *start, size_t size, void *owner, PoolKind kind);
+
+/**
+ * @brief: Removes the registration of a memory range.
+ *
+ * @param start: Start of the range passed to pool_registry_add.
+ * @param size: Size of the range passed to pool_registry_add.
+ */
+void pool_registry_remove(const void *start, size_t size);
+
+/**
+ * @brief: Finds the owner of the memory the pointer points to.
+ *
+ * @param ptr: Any pointer.
+ * @param kind: Receives the type of the owner, may be NULL.
+ * @return: Owner of the page, NULL if the page is not registered.
+ */
+void *pool_registry_find(const void *ptr, PoolKind *kind);
+
+#endif // POOL_REGISTRY_H
@@ -9,7 +9,8 @@ static logLevel file_log_level = LOG_LEVEL_FATAL;
 static logLevel stdout_log_level = LOG_LEVEL_FATAL;
 static FILE *log_file = NULL;
 
-char logger_buffer[256];
+// Each thread formats its messages in its own buffer
+_Thread_local char logger_buffer[256];
 
 void logToStdoutEnable(logLevel level)
 {
@@ -62,6 +63,12 @@ void fileLogging(const char *message)
     fprintf(log_file, "%s %s\n", ctime(&m_time), message);
 }
 
+int logLevelEnabled(logLevel level)
+{
+    return (log_to_file && level >= file_log_level) ||
+        (log_to_stdout && level >= stdout_log_level);
+}
+
 void logging(const char *message, logLevel level)
 {
     if (log_to_file && level >= file_log_level)
@@ -21,6 +21,13 @@ typedef enum {
  */
 void logging(const char *message, logLevel level);
 
+/**
+ * @brief Checks whether a message of the given level would be logged
+ * @param level Level of the message
+ * @return Non-zero if the message reaches at least one destination
+ */
+int logLevelEnabled(logLevel level);
+
 /**
  * @brief Sends error messages to standart output
  * @param message Error message
@@ -3,17 +3,254 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 #include <pool_errors.h>
 #include <pool_logger.h>
 #include <log_macros.h>
+#include <pool_registry.h>
+#include <pool_pages.h>
 #include <block_pool.h>
 
-extern char logger_buffer[256];
+extern _Thread_local char logger_buffer[256];
+
+// Number of bitmap words needed to describe the given number of blocks.
+#define BITMAP_WORDS(blocks) (((blocks) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS)
+
+/**
+ * @brief Resets the bitmap word, if the slab has one with this index.
+ *
+ * The bits of the last word that do not correspond to any block are
+ * marked busy, so the search never has to check the slab boundary.
+ */
+static inline void bitmap_reset_word(BlockSlab *slab, size_t i)
+{
+    if (i >= BITMAP_WORDS(slab->capacity))
+        return;
+
+    size_t tail = slab->capacity - i * BITMAP_WORD_BITS;
+    slab->bitmap[i] = (tail < BITMAP_WORD_BITS) ? ~(uint64_t) 0 << tail : 0;
+}
+
+/**
+ * @brief Marks all the blocks of the slab as free.
+ *
+ * Only the high-water marks are rewound, the headers and the bitmap
+ * words above them are reset when allocation reaches them.
+ */
+static void slab_reset(const PoolBlock *pool, BlockSlab *slab)
+{
+    /**
+     * Blocks are handed out from the untouched part of the buffer first,
+     * so the free list does not have to be built up front.
+     */
+    slab->free_list = NULL;
+    slab->untouched = slab->mem;
+    slab->size = 0;
+    slab->hint = 0;
+    slab->fresh = 0;
+
+    if (pool->flags & POOL_BLOCK_BITMAP)
+        bitmap_reset_word(slab, 0);
+}
+
+/**
+ * @brief Returns the size of the slab buffer, rounded up to whole pages
+ * so that no other slab or pool shares a page of the registry with it.
+ */
+static inline size_t slab_mem_size(const PoolBlock *pool, size_t capacity)
+{
+    size_t page = (pool->flags & POOL_BLOCK_HUGE_PAGES) ? POOL_PAGES_HUGE_SIZE : REGISTRY_PAGE_SIZE;
+    return MULTIPLE_UP(capacity * pool->block_size, page);
+}
+
+/**
+ * @brief Allocates a slab and links it to the pool.
+ *
+ * @param pool Pointer to the memory pool.
+ * @param capacity Number of blocks in the new slab.
+ * @return Pointer to the new slab, NULL if the memory could not be allocated.
+ */
+static BlockSlab *slab_create(PoolBlock *pool, size_t capacity)
+{
+    size_t bitmap_size = (pool->flags & POOL_BLOCK_BITMAP) ?
+        BITMAP_WORDS(capacity) * sizeof(uint64_t) : 0;
+
+    if (capacity > SIZE_MAX / pool->block_size)
+        return NULL;
+
+    BlockSlab *slab = calloc(1, sizeof(BlockSlab) + bitmap_size);
+    if (!slab)
+        return NULL;
+
+    // The buffer is zero, pool_block_calloc does not clear it again
+    size_t mem_size = slab_mem_size(pool, capacity);
+    slab->mem = (pool->flags & POOL_BLOCK_HUGE_PAGES) ?
+        pool_pages_alloc_huge(mem_size, &slab->pages) : pool_pages_alloc(mem_size);
+    if (!slab->mem)
+    {
+        free(slab);
+        return NULL;
+    }
+
+    if (!pool_registry_add(slab->mem, mem_size, slab, POOL_KIND_BLOCK))
+    {
+        pool_pages_free(slab->mem, mem_size);
+        free(slab);
+        return NULL;
+    }
+
+    slab->zeroed = slab->mem;
+    slab->pool = pool;
+    slab->capacity = capacity;
+    slab_reset(pool, slab);
+
+    // New slabs are appended, so the first slab stays the oldest one
+    if (pool->slabs)
+    {
+        BlockSlab *last = pool->slabs->prev;
+        last->next = slab;
+        slab->prev = last;
+        pool->slabs->prev = slab;
+    }
+    else
+    {
+        pool->slabs = slab;
+        slab->prev = slab;
+        pool->mem_pool = slab->mem;
+    }
+
+    // A new slab is completely free
+    slab->next_partial = pool->partial;
+    if (pool->partial)
+        pool->partial->prev_partial = slab;
+    pool->partial = slab;
+
+    pool->capacity += capacity;
+    return slab;
+}
+
+/**
+ * @brief Removes the slab from the list of slabs with free blocks.
+ */
+static void partial_remove(PoolBlock *pool, BlockSlab *slab)
+{
+    if (slab->prev_partial)
+        slab->prev_partial->next_partial = slab->next_partial;
+    else
+        pool->partial = slab->next_partial;
+
+    if (slab->next_partial)
+        slab->next_partial->prev_partial = slab->prev_partial;
+
+    slab->next_partial = slab->prev_partial = NULL;
+}
+
+/**
+ * @brief Adds the slab to the list of slabs with free blocks.
+ */
+static void partial_push(PoolBlock *pool, BlockSlab *slab)
+{
+    slab->prev_partial = NULL;
+    slab->next_partial = pool->partial;
+    if (pool->partial)
+        pool->partial->prev_partial = slab;
+    pool->partial = slab;
+}
+
+/**
+ * @brief Unlinks the slab from the pool and frees its memory.
+ *
+ * The slab list is circular through the prev links of the first slab,
+ * so the last slab is reachable in constant time.
+ */
+static void slab_destroy(PoolBlock *pool, BlockSlab *slab)
+{
+    if (slab->next_partial || slab->prev_partial || pool->partial == slab)
+        partial_remove(pool, slab);
+
+    if (slab == pool->slabs)
+    {
+        pool->slabs = slab->next;
+        if (pool->slabs)
+        {
+            pool->slabs->prev = slab->prev;
+            pool->mem_pool = pool->slabs->mem;
+        }
+        else
+            pool->mem_pool = NULL;
+    }
+    else
+    {
+        slab->prev->next = slab->next;
+        if (slab->next)
+            slab->next->prev = slab->prev;
+        else
+            pool->slabs->prev = slab->prev;
+    }
+
+    pool->capacity -= slab->capacity;
+    pool_registry_remove(slab->mem, slab_mem_size(pool, slab->capacity));
+    pool_pages_free(slab->mem, slab_mem_size(pool, slab->capacity));
+    free(slab);
+}
+
+/**
+ * @brief Acquires a new slab according to the growth policy of the pool.
+ *
+ * @return 'true' if the pool has grown, otherwise 'false'.
+ */
+static bool pool_block_grow(PoolBlock *pool)
+{
+    size_t capacity;
+    switch (pool->growth)
+    {
+        case POOL_GROW_DOUBLE:
+            capacity = pool->capacity;
+            break;
+        case POOL_GROW_FIXED:
+            capacity = pool->growth_step;
+            break;
+        default:
+            return false;
+    }
+
+    return slab_create(pool, capacity) != NULL;
+}
 
 PoolBlock *pool_block_create(size_t capacity, size_t block_size)
+{
+    return pool_block_create_ex(capacity, block_size, NULL);
+}
+
+PoolBlock *pool_block_create_aligned(size_t capacity, size_t block_size,
+        size_t alignment)
+{
+    PoolBlockOptions options = { .alignment = alignment };
+
+    // Zero would silently select the default alignment
+    if (alignment == 0)
+    {
+        LOG_POOL_INVALID_ARGS;
+        pool_last_error = POOL_INVALID_ARGS;
+        return NULL;
+    }
+
+    return pool_block_create_ex(capacity, block_size, &options);
+}
+
+PoolBlock *pool_block_create_ex(size_t capacity, size_t block_size,
+        const PoolBlockOptions *options)
 {
     pool_last_error = POOL_OK;
-    if ((capacity == 0) || (block_size == 0))
+    size_t alignment = (options && options->alignment) ?
+        options->alignment : BLOCK_POOL_ALIGNMENT;
+    bool handles = options && (options->flags & POOL_BLOCK_HANDLES);
+    if ((capacity == 0) || (block_size == 0) ||
+            (options && options->growth == POOL_GROW_FIXED && options->growth_step == 0) ||
+            (alignment & (alignment - 1)) || alignment > BLOCK_POOL_MAX_ALIGNMENT ||
+            (handles && (options->growth != POOL_GROW_NONE ||
+                         capacity > POOL_HANDLE_MAX_CAPACITY)))
     {
         LOG_POOL_INVALID_ARGS;
         pool_last_error = POOL_INVALID_ARGS;
@@ -28,35 +265,161 @@ PoolBlock *pool_block_create(size_t capacity, size_t block_size)
         return NULL;
     }
 
+    if (options)
+    {
+        new_pool->flags = options->flags;
+        new_pool->growth = options->growth;
+        new_pool->growth_step = options->growth_step;
+        new_pool->trim_threshold = options->trim_threshold;
+    }
+
     /**
-     * The block size must be a multiple of the alignment.
-     * We add the alignment value to be able to offset the payload
-     * within the block.
+     * Smaller alignments are raised to the size of the header word.
+     * Blocks padded to cache lines never share a line with their
+     * neighbours, so they are aligned to the line as well.
      */
-    size_t mult_block_size = MULTIPLE_UP(block_size, BLOCK_POOL_ALIGNMENT) +
-        BLOCK_POOL_ALIGNMENT;
+    if (alignment < BLOCK_POOL_ALIGNMENT)
+        alignment = BLOCK_POOL_ALIGNMENT;
+    if ((new_pool->flags & POOL_BLOCK_CACHE_ALIGNED) && alignment < CACHE_LINE_SIZE)
+        alignment = CACHE_LINE_SIZE;
 
-    byte (*mem_pool)[mult_block_size] = 
-        calloc(capacity, mult_block_size);
-    if (!mem_pool)
-        goto buffer_allocation_error;
+    /**
+     * The block size must be a multiple of the alignment.
+     * In the header layout we add the alignment value to reserve a header
+     * in front of the payload: it holds the busy marker or the free list
+     * link. In the bitmap layout the block holds the payload only.
+     * The slab buffers are aligned to pages, so every block is aligned.
+     */
+    size_t mult_block_size = MULTIPLE_UP(block_size, alignment);
+    size_t offset = 0;
+    if (!(new_pool->flags & POOL_BLOCK_BITMAP))
+    {
+        offset = alignment;
+        mult_block_size += offset;
+    }
 
-    new_pool->mem_pool = mem_pool;
-    new_pool->capacity = capacity;
+    new_pool->alignment = alignment;
     new_pool->block_size = mult_block_size;
     new_pool->size = 0;
-    new_pool->last_clear = NULL;
-    new_pool->offset = MULTIPLE_UP((uintptr_t) mem_pool, BLOCK_POOL_ALIGNMENT) -
-        (uintptr_t) mem_pool;
-
-    return new_pool;
+    new_pool->offset = offset;
 
+    /**
+     * Handles refer to the blocks of the only slab by index, the index
+     * takes as few bits as the capacity allows.
+     */
+    if (handles)
+    {
+        new_pool->generations = calloc(capacity, sizeof(uint32_t));
+        while (((size_t) 1 << new_pool->handle_bits) < capacity)
+            ++new_pool->handle_bits;
+    }
 
-    buffer_allocation_error:
+    if ((handles && !new_pool->generations) || !slab_create(new_pool, capacity))
+    {
         LOG_POOL_CREATE_ERROR(sizeof(PoolBlock) + (capacity * block_size));
         pool_last_error = POOL_ALLOC_FAILED;
+        free(new_pool->generations);
         free(new_pool);
-    return NULL;
+        return NULL;
+    }
+
+    return new_pool;
+}
+
+/**
+ * @brief Starts a new generation of the block, so the handles of its
+ * previous allocations no longer match.
+ *
+ * The generation takes the handle bits above the index and is never 0,
+ * so no handle is equal to POOL_NULL_HANDLE.
+ */
+static inline void block_generation_next(const PoolBlock *pool, size_t index)
+{
+    uint32_t mask = UINT32_MAX >> pool->handle_bits;
+    uint32_t generation = (pool->generations[index] + 1) & mask;
+    pool->generations[index] = generation ? generation : 1;
+}
+
+/**
+ * @brief Takes the first free block marked in the slab bitmap.
+ *
+ * Words without free blocks are skipped as a whole, the free bit inside
+ * the word is found with a single count-trailing-zeros instruction.
+ *
+ * The word right above the high-water mark is always reset, so the search
+ * stops there at the latest without checking the mark. When that word
+ * comes into use, the next one is reset in its turn.
+ */
+static void *bitmap_alloc(const PoolBlock *pool, BlockSlab *slab)
+{
+    size_t i = slab->hint;
+    while (slab->bitmap[i] == ~(uint64_t) 0)
+        ++i;
+
+    if (i == slab->fresh)
+    {
+        bitmap_reset_word(slab, ++slab->fresh);
+
+        // The whole word counts as used, so the mark moves rarely
+        byte *word_end = (byte *) slab->mem + slab->fresh * BITMAP_WORD_BITS * pool->block_size;
+        if ((void *) word_end > slab->zeroed)
+            slab->zeroed = word_end;
+    }
+
+    unsigned int bit = __builtin_ctzll(~slab->bitmap[i]);
+    slab->bitmap[i] |= (uint64_t) 1 << bit;
+    slab->hint = i;
+
+    size_t index = i * BITMAP_WORD_BITS + bit;
+    if (pool->generations)
+        block_generation_next(pool, index);
+    return (byte *) slab->mem + index * pool->block_size;
+}
+
+/**
+ * @brief Takes a free block from the slab.
+ *
+ * The slab must have free blocks. The counters are updated separately
+ * by slab_taken(), so a batch pays for them once.
+ */
+static inline void *slab_take(const PoolBlock *pool, BlockSlab *slab)
+{
+    if (pool->flags & POOL_BLOCK_BITMAP)
+        return bitmap_alloc(pool, slab);
+
+    uintptr_t *header;
+
+    // Taking the last freed block, otherwise the next untouched one
+    if (slab->free_list)
+    {
+        header = slab->free_list;
+        slab->free_list = (void *) *header;
+    }
+    else
+    {
+        header = slab->untouched;
+        slab->untouched = (byte *) header + pool->block_size;
+        if (slab->untouched > slab->zeroed)
+            slab->zeroed = slab->untouched;
+    }
+
+    *header = BLOCK_BUSY;
+    if (pool->generations)
+        block_generation_next(pool, ((byte *) header - (byte *) slab->mem) / pool->block_size);
+    return (byte *) header + pool->offset;
+}
+
+/**
+ * @brief Accounts for the blocks taken from the slab.
+ */
+static inline void slab_taken(PoolBlock *pool, BlockSlab *slab, size_t count)
+{
+    if (slab == pool->empty)
+        pool->empty = NULL;
+    slab->size += count;
+    if (slab->size == slab->capacity)
+        partial_remove(pool, slab);
+    pool->size += count;
 }
 
 void *pool_block_alloc(PoolBlock *pool)
@@ -70,53 +433,209 @@ void *pool_block_alloc(PoolBlock *pool)
         return NULL;
     }
 
-    if (pool->size == pool->capacity)
+    if (pool->size == pool->capacity && !pool_block_grow(pool))
     {
         LOG_POOL_NOT_FREE_SPACE(pool->mem_pool, pool->capacity - pool->size, pool->block_size);
         pool_last_error = POOL_ALLOC_FAILED;
         return NULL;
     }
 
-    byte (*buffer)[pool->block_size] = pool->mem_pool;
-    byte *free_flag = NULL;
+    // The pool is not full, so there is a slab with free blocks
+    BlockSlab *slab = pool->partial;
+    void *block = slab_take(pool, slab);
+    slab_taken(pool, slab, 1);
+
+    LOG_BLOCK_ALLOCATION(pool->mem_pool, block, pool->block_size);
+    return block;
+}
+
+void *pool_block_calloc(PoolBlock *pool)
+{
+    pool_last_error = POOL_OK;
 
-    // Checking the last freed block
-    if (pool->last_clear)
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return NULL;
+    }
+
+    if (pool->size == pool->capacity && !pool_block_grow(pool))
     {
-        free_flag = pool->last_clear;
-        if (*free_flag == 0)
+        LOG_POOL_NOT_FREE_SPACE(pool->mem_pool, pool->capacity - pool->size, pool->block_size);
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+
+    BlockSlab *slab = pool->partial;
+    void *zeroed = slab->zeroed;
+    byte *block = slab_take(pool, slab);
+    slab_taken(pool, slab, 1);
+
+    // Only blocks that were allocated before have to be cleared
+    if ((void *) (block - pool->offset) < zeroed)
+        memset(block, 0, pool->block_size - pool->offset);
+
+    LOG_BLOCK_ALLOCATION(pool->mem_pool, block, pool->block_size);
+    return block;
+}
+
+size_t pool_block_alloc_n(PoolBlock *pool, void **out, size_t n)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !out)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    size_t count = 0;
+    while (count < n)
+    {
+        if (pool->size == pool->capacity && !pool_block_grow(pool))
         {
-            *free_flag = 1;
-            ++pool->size;
-            pool->last_clear = NULL;
-            LOG_BLOCK_ALLOCATION(pool->mem_pool, (void *) (free_flag + pool->offset), pool->block_size);
-            return (void *) (free_flag + pool->offset);
+            LOG_POOL_NOT_FREE_SPACE(pool->mem_pool, pool->capacity - pool->size, pool->block_size);
+            pool_last_error = POOL_ALLOC_FAILED;
+            break;
         }
+
+        // Taking as many blocks as possible from the slab in one go
+        BlockSlab *slab = pool->partial;
+        size_t take = slab->capacity - slab->size;
+        if (take > n - count)
+            take = n - count;
+
+        for (size_t i = 0; i < take; ++i)
+            out[count + i] = slab_take(pool, slab);
+
+        slab_taken(pool, slab, take);
+        count += take;
+    }
+
+    if (count)
+        LOG_BLOCK_BATCH_ALLOCATION(pool->mem_pool, count, pool->block_size);
+    return count;
+}
+
+PoolHandle pool_block_alloc_handle(PoolBlock *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return POOL_NULL_HANDLE;
+    }
+
+    if (!pool->generations)
+    {
+        LOG_POOL_INVALID_ARGS;
+        pool_last_error = POOL_INVALID_ARGS;
+        return POOL_NULL_HANDLE;
+    }
+
+    byte *block = pool_block_alloc(pool);
+    if (!block)
+        return POOL_NULL_HANDLE;
+
+    size_t index = (block - pool->offset - (byte *) pool->mem_pool) / pool->block_size;
+    return (PoolHandle) (pool->generations[index] << pool->handle_bits) | (PoolHandle) index;
+}
+
+void *pool_block_deref(const PoolBlock *pool, PoolHandle handle)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        pool_last_error = POOL_NULL_PTR;
+        return NULL;
     }
 
-    /*
-     * We loop through the blocks and check the busy flags (first byte), if the 
-     * block is free then we return the pointer to the second byte of the block
+    size_t index = handle & (((size_t) 1 << pool->handle_bits) - 1);
+    if (!pool->generations || index >= pool->capacity ||
+            pool->generations[index] != handle >> pool->handle_bits)
+    {
+        pool_last_error = POOL_INVALID_PTR;
+        return NULL;
+    }
+
+    /**
+     * The generation of a freed block changes only when it is allocated
+     * again, until then the block itself must be busy.
      */
+    const BlockSlab *slab = pool->slabs;
+    byte *block = (byte *) slab->mem + index * pool->block_size;
+    bool busy;
+    if (pool->flags & POOL_BLOCK_BITMAP)
+        busy = index / BITMAP_WORD_BITS < slab->fresh &&
+            (slab->bitmap[index / BITMAP_WORD_BITS] >> (index % BITMAP_WORD_BITS)) & 1;
+    else
+        busy = (void *) block < slab->untouched && *(uintptr_t *) block == BLOCK_BUSY;
 
-    free_flag = pool->mem_pool;
+    if (!busy)
+    {
+        pool_last_error = POOL_INVALID_PTR;
+        return NULL;
+    }
+
+    return block + pool->offset;
+}
 
-    // Looking for a free block
-    for (int i = 0; i < pool->capacity; ++i)
+void pool_block_free_handle(PoolBlock *pool, PoolHandle handle)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
     {
-        if (*free_flag == 0)
-        {
-            *free_flag = 1;
-            ++pool->size;
-            LOG_BLOCK_ALLOCATION(pool->mem_pool, (void *) (free_flag + pool->offset), pool->block_size);
-            return (void *) (free_flag + pool->offset);
-        }
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
 
-        free_flag += pool->block_size;
+    void *memblock = pool_block_deref(pool, handle);
+    if (!memblock)
+    {
+        LOG_POOL_INVALID_PTR((void *) (uintptr_t) handle);
+        return;
     }
 
-    pool_last_error = POOL_ALLOC_FAILED;
-    return NULL;
+    pool_block_free(pool, memblock);
+}
+
+/**
+ * @brief Finds the slab the block belongs to.
+ *
+ * The slab is looked up in the pool registry, so the search does not
+ * depend on the number of slabs.
+ *
+ * @param pool Pointer to the memory pool.
+ * @param memblock Pointer to a memory block.
+ * @return Pointer to the slab, NULL if the pointer is not the start of
+ * a block in the pool.
+ */
+static BlockSlab *pool_block_find_slab(const PoolBlock *pool, const void *memblock)
+{
+    PoolKind kind;
+    BlockSlab *slab = pool_registry_find(memblock, &kind);
+
+    // Check if the block is within the bounds of the slab's memory.
+    const byte *slab_start = slab ? (const byte *) slab->mem + pool->offset : NULL;
+    if (kind != POOL_KIND_BLOCK || slab->pool != pool ||
+            (const byte *) memblock < slab_start ||
+            (const byte *) memblock >= slab_start + (slab->capacity * pool->block_size))
+    {
+        LOG_POOL_ALIEN_PTR(memblock);
+        return NULL;
+    }
+
+    // Check if the block is the start of block in the slab.
+    if (((uintptr_t) memblock - (uintptr_t) slab_start) % pool->block_size != 0)
+    {
+        LOG_POOL_PTR_NOT_ALIGNMENT(memblock);
+        return NULL;
+    }
+
+    return slab;
 }
 
 /*
@@ -124,28 +643,135 @@ void *pool_block_alloc(PoolBlock *pool)
  *
  * @param pool: Pointer to the memory pool.
  * @param memblock: Pointer to a memory block.
- * @return: 'true' if the memory block is in the pool and corectly aligned,
- * otherwise 'false'.
+ * @return: 'true' if the memory block is in one of the pool slabs and
+ * corectly aligned, otherwise 'false'.
  */
 bool pool_block_contains(const PoolBlock *pool, const void *memblock)
 {
-    // Check if the block is within the bounds of the pool's memory.
-    void *pool_start = pool->mem_pool;
-    void *pool_end = pool_start + (pool->capacity * pool->block_size);
-    if (memblock < pool_start || memblock > pool_end)
+    return pool_block_find_slab(pool, memblock) != NULL;
+}
+
+/**
+ * @brief Returns the block to the slab.
+ *
+ * The counters are updated separately by slab_returned(), so a batch
+ * pays for them once.
+ *
+ * @return 'false' if the block is already free (double free).
+ */
+static inline bool slab_put(const PoolBlock *pool, BlockSlab *slab, void *memblock)
+{
+    if (pool->flags & POOL_BLOCK_BITMAP)
     {
-        LOG_POOL_ALIEN_PTR(memblock);
+        size_t index = ((byte *) memblock - (byte *) slab->mem) / pool->block_size;
+        size_t word = index / BITMAP_WORD_BITS;
+        uint64_t mask = (uint64_t) 1 << (index % BITMAP_WORD_BITS);
+
+        // Words above the high-water mark hold bits of the previous cleanups
+        if (word >= slab->fresh || !(slab->bitmap[word] & mask))
+            return false;
+
+        slab->bitmap[word] &= ~mask;
+        if (word < slab->hint)
+            slab->hint = word;
+        return true;
+    }
+
+    // The header is located right in front of the payload.
+    // Headers in the untouched part are left from the previous cleanups
+    uintptr_t *header = (uintptr_t *) ((byte *) memblock - pool->offset);
+    if ((void *) header >= slab->untouched || *header != BLOCK_BUSY)
         return false;
+
+    *header = (uintptr_t) slab->free_list;
+    slab->free_list = header;
+    return true;
+}
+
+/**
+ * @brief Returns the number of bytes of the slab used since its last cleanup.
+ */
+static inline size_t slab_extent(const PoolBlock *pool, const BlockSlab *slab)
+{
+    if (pool->flags & POOL_BLOCK_BITMAP)
+        return slab->fresh * BITMAP_WORD_BITS * pool->block_size;
+    return (size_t) ((byte *) slab->untouched - (byte *) slab->mem);
+}
+
+/**
+ * @brief Releases the pages of the free blocks of the slab.
+ * @return Number of bytes released.
+ */
+static size_t slab_trim(const PoolBlock *pool, BlockSlab *slab)
+{
+    byte *mem = slab->mem;
+    byte *end = mem + slab_mem_size(pool, slab->capacity);
+
+    // The slab being visited by pool_block_foreach is not rewound
+    if (slab->size == 0 && slab != pool->pinned)
+    {
+        slab_reset(pool, slab);
+        return pool_pages_release(mem, end, slab->pages);
     }
 
-    // Check if the block is the start of block in the pool.
-    if (((uintptr_t) memblock - (uintptr_t)pool_start) %
-        pool->block_size == 0)
-        return true;
-    else
+    // In the header layout only the untouched part holds no free list links
+    if (!(pool->flags & POOL_BLOCK_BITMAP))
+        return pool_pages_release(slab->untouched, end, slab->pages);
+
+    // Runs of free blocks between the busy ones, the words above the mark are free
+    size_t released = 0;
+    size_t run = 0;
+    for (size_t i = 0; i < slab->fresh; ++i)
     {
-        LOG_POOL_PTR_NOT_ALIGNMENT(memblock);
+        uint64_t busy = slab->bitmap[i];
+        while (busy)
+        {
+            size_t index = i * BITMAP_WORD_BITS + __builtin_ctzll(busy);
+            busy &= busy - 1;
+            if (index >= slab->capacity)
+                break;
+
+            released += pool_pages_release(mem + run * pool->block_size,
+                    mem + index * pool->block_size, slab->pages);
+            run = index + 1;
+        }
     }
+
+    return released + pool_pages_release(mem + run * pool->block_size, end, slab->pages);
+}
+
+/**
+ * @brief Accounts for the blocks returned to the slab.
+ *
+ * A growable pool releases the slabs that become completely empty.
+ * One empty slab is kept, otherwise alternating allocation and release
+ * on the growth boundary would create and destroy a slab every time.
+ * The kept slab and the empty slabs of a fixed pool are trimmed if they
+ * used at least trim_threshold bytes since their last cleanup.
+ *
+ * @return 'false' if the slab was released.
+ */
+static bool slab_returned(PoolBlock *pool, BlockSlab *slab, size_t count)
+{
+    if (slab->size == slab->capacity)
+        partial_push(pool, slab);
+    slab->size -= count;
+    pool->size -= count;
+
+    if (slab->size == 0 && pool->growth != POOL_GROW_NONE && slab != pool->pinned)
+    {
+        if (!pool->empty)
+            pool->empty = slab;
+        else
+        {
+            slab_destroy(pool, slab);
+            return false;
+        }
+    }
+
+    if (slab->size == 0 && pool->trim_threshold && slab_extent(pool, slab) >= pool->trim_threshold)
+        slab_trim(pool, slab);
+    return true;
 }
 
 void pool_block_free(PoolBlock *pool, void *memblock)
@@ -159,26 +785,315 @@ void pool_block_free(PoolBlock *pool, void *memblock)
     }
 
     /**
-     * Calculate the address of the flag byte (the first byte of the block).
-     * The user is given a pointer to the second byte of the block, so we
-     * decrement it by 1.
+     * Check if the pointer is within the memory range of one of the slabs
+     * and if it is the start of a block.
      */
-    byte *free_flag = (byte *) memblock - pool->offset;
+    BlockSlab *slab = pool_block_find_slab(pool, memblock);
+    if (!slab)
+    {
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
 
-    /**
-     * Check if the flag byte is within the pool's memory range and if it
-     * is the start of a block.
-     */
-    if (!pool_block_contains(pool, memblock))
+    if (!slab_put(pool, slab, memblock))
     {
+        LOG_POOL_INVALID_PTR(memblock);
         pool_last_error = POOL_INVALID_PTR;
         return;
     }
 
-    *free_flag = 0;
-    pool->last_clear = free_flag;
-    --pool->size;
     LOG_BLOCK_FREE(pool->mem_pool, memblock, pool->block_size);
+    slab_returned(pool, slab, 1);
+}
+
+size_t pool_block_free_n(PoolBlock *pool, void **in, size_t n)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !in)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    size_t count = 0;
+    BlockSlab *slab = NULL;     // Slab of the current run of blocks
+    size_t run = 0;             // Blocks returned to it so far
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        void *memblock = in[i];
+        if (!memblock)
+        {
+            LOG_POOL_NULL_PTR;
+            pool_last_error = POOL_NULL_PTR;
+            continue;
+        }
+
+        /**
+         * Blocks of a batch usually come from the same slab, so the slab
+         * of the previous block is checked before searching all of them.
+         */
+        const byte *slab_start = slab ? (const byte *) slab->mem + pool->offset : NULL;
+        if (!slab || (const byte *) memblock < slab_start ||
+                (const byte *) memblock >= slab_start + slab->capacity * pool->block_size ||
+                ((const byte *) memblock - slab_start) % pool->block_size != 0)
+        {
+            if (run && !slab_returned(pool, slab, run))
+                slab = NULL;
+            run = 0;
+
+            slab = pool_block_find_slab(pool, memblock);
+            if (!slab)
+            {
+                pool_last_error = POOL_INVALID_PTR;
+                continue;
+            }
+        }
+
+        if (!slab_put(pool, slab, memblock))
+        {
+            LOG_POOL_INVALID_PTR(memblock);
+            pool_last_error = POOL_INVALID_PTR;
+            continue;
+        }
+
+        ++run;
+        ++count;
+    }
+
+    if (run)
+        slab_returned(pool, slab, run);
+
+    if (count)
+        LOG_BLOCK_BATCH_FREE(pool->mem_pool, count, pool->block_size);
+    return count;
+}
+
+/**
+ * @brief Calls the visitor for the busy blocks of the slab with indices
+ * in [first, last).
+ *
+ * The busy bits of a bitmap word are read once, so the visitor may free
+ * the visited block.
+ */
+static void slab_visit(const PoolBlock *pool, const BlockSlab *slab, size_t first,
+        size_t last, PoolBlockVisitor visitor, void *ctx)
+{
+    byte *mem = slab->mem;
+
+    if (!(pool->flags & POOL_BLOCK_BITMAP))
+    {
+        // Blocks in the untouched part are free
+        size_t end = ((byte *) slab->untouched - mem) / pool->block_size;
+        for (size_t i = first; i < end && i < last; ++i)
+        {
+            uintptr_t *header = (uintptr_t *) (mem + i * pool->block_size);
+            if (*header == BLOCK_BUSY)
+                visitor((byte *) header + pool->offset, ctx);
+        }
+        return;
+    }
+
+    // Words above the high-water mark have no busy blocks
+    if (last > slab->fresh * BITMAP_WORD_BITS)
+        last = slab->fresh * BITMAP_WORD_BITS;
+
+    for (size_t i = first; i < last; i = (i / BITMAP_WORD_BITS + 1) * BITMAP_WORD_BITS)
+    {
+        size_t word = i / BITMAP_WORD_BITS;
+        uint64_t bits = slab->bitmap[word] & (~(uint64_t) 0 << (i % BITMAP_WORD_BITS));
+
+        // The bits past the range (or past the last block) are not visited
+        size_t span = last - word * BITMAP_WORD_BITS;
+        if (span < BITMAP_WORD_BITS)
+            bits &= ((uint64_t) 1 << span) - 1;
+
+        while (bits)
+        {
+            unsigned int bit = __builtin_ctzll(bits);
+            bits &= bits - 1;
+            visitor(mem + (word * BITMAP_WORD_BITS + bit) * pool->block_size, ctx);
+        }
+    }
+}
+
+void pool_block_foreach(PoolBlock *pool, PoolBlockVisitor visitor, void *ctx)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !visitor)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    BlockSlab *slab = pool->slabs;
+    while (slab)
+    {
+        /**
+         * The visitor may free the last busy block of the slab, then the
+         * slab is released only after it has been visited.
+         */
+        pool->pinned = slab;
+        slab_visit(pool, slab, 0, slab->capacity, visitor, ctx);
+        pool->pinned = NULL;
+
+        BlockSlab *next = slab->next;
+        if (slab->size == 0 && slab != pool->empty)
+            slab_returned(pool, slab, 0);
+        slab = next;
+    }
+
+    // Errors of the frees done by the visitor are not errors of the iteration
+    pool_last_error = POOL_OK;
+}
+
+/* Range of blocks visited by one thread */
+typedef struct visit_task {
+    const PoolBlock *pool;
+    size_t first;               // Index of the first block (over all slabs).
+    size_t last;                // Index past the last block.
+    PoolBlockVisitor visitor;
+    void *ctx;
+    pthread_t thread;           // Thread visiting the range.
+    bool started;               // The thread was started.
+} VisitTask;
+
+/**
+ * @brief Visits the busy blocks of the range, the slabs are numbered
+ * one after another in the order of the slab list.
+ */
+static void *visit_task(void *arg)
+{
+    const VisitTask *task = arg;
+    size_t start = 0;   // Index of the first block of the slab
+
+    for (BlockSlab *slab = task->pool->slabs; slab && start < task->last;
+            start += slab->capacity, slab = slab->next)
+    {
+        if (start + slab->capacity <= task->first)
+            continue;
+
+        size_t first = (task->first > start) ? task->first - start : 0;
+        size_t last = (task->last - start < slab->capacity) ?
+            task->last - start : slab->capacity;
+        slab_visit(task->pool, slab, first, last, task->visitor, task->ctx);
+    }
+
+    return NULL;
+}
+
+void pool_block_foreach_parallel(PoolBlock *pool, PoolBlockVisitor visitor, void *ctx,
+        size_t threads)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !visitor)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    if (threads == 0)
+    {
+        LOG_POOL_INVALID_ARGS;
+        pool_last_error = POOL_INVALID_ARGS;
+        return;
+    }
+
+    // Every thread gets a whole number of bitmap words
+    size_t chunk = MULTIPLE_UP((pool->capacity + threads - 1) / threads, BITMAP_WORD_BITS);
+    threads = (pool->capacity + chunk - 1) / chunk;
+
+    VisitTask *tasks = calloc(threads, sizeof(VisitTask));
+    if (!tasks)
+    {
+        // Without the bookkeeping the whole pool is visited by this thread
+        VisitTask task = { .pool = pool, .first = 0, .last = pool->capacity,
+                .visitor = visitor, .ctx = ctx };
+        visit_task(&task);
+        return;
+    }
+
+    for (size_t i = 0; i < threads; ++i)
+    {
+        tasks[i] = (VisitTask) { .pool = pool, .first = i * chunk, .last = (i + 1) * chunk,
+                .visitor = visitor, .ctx = ctx };
+
+        // The first range is visited by the calling thread
+        if (i > 0)
+            tasks[i].started = pthread_create(&tasks[i].thread, NULL, visit_task,
+                    &tasks[i]) == 0;
+    }
+
+    // Ranges whose thread could not be started are visited here as well
+    for (size_t i = 0; i < threads; ++i)
+        if (!tasks[i].started)
+            visit_task(&tasks[i]);
+
+    for (size_t i = 1; i < threads; ++i)
+        if (tasks[i].started)
+            pthread_join(tasks[i].thread, NULL);
+
+    free(tasks);
+}
+
+void pool_block_iter_init(PoolBlockIter *iter, const PoolBlock *pool)
+{
+    iter->pool = pool;
+    iter->slab = pool ? pool->slabs : NULL;
+    iter->index = 0;
+    iter->bits = 0;
+}
+
+void *pool_block_iter_next(PoolBlockIter *iter)
+{
+    const PoolBlock *pool = iter->pool;
+
+    for (; iter->slab; iter->slab = iter->slab->next, iter->index = 0, iter->bits = 0)
+    {
+        BlockSlab *slab = iter->slab;
+        byte *mem = slab->mem;
+
+        if (!(pool->flags & POOL_BLOCK_BITMAP))
+        {
+            size_t end = ((byte *) slab->untouched - mem) / pool->block_size;
+            while (iter->index < end)
+            {
+                uintptr_t *header = (uintptr_t *) (mem + iter->index++ * pool->block_size);
+                if (*header == BLOCK_BUSY)
+                    return (byte *) header + pool->offset;
+            }
+            continue;
+        }
+
+        /**
+         * The index points past the word whose busy bits are being
+         * returned, the next word is loaded when they run out.
+         */
+        while (!iter->bits)
+        {
+            size_t word = iter->index / BITMAP_WORD_BITS;
+            if (word >= slab->fresh)
+                break;
+
+            iter->bits = slab->bitmap[word];
+            size_t span = slab->capacity - word * BITMAP_WORD_BITS;
+            if (span < BITMAP_WORD_BITS)
+                iter->bits &= ((uint64_t) 1 << span) - 1;
+            iter->index += BITMAP_WORD_BITS;
+        }
+
+        if (iter->bits)
+        {
+            unsigned int bit = __builtin_ctzll(iter->bits);
+            iter->bits &= iter->bits - 1;
+            return mem + (iter->index - BITMAP_WORD_BITS + bit) * pool->block_size;
+        }
+    }
+
+    return NULL;
 }
 
 void pool_block_clear(PoolBlock *pool)
@@ -194,14 +1109,45 @@ void pool_block_clear(PoolBlock *pool)
     if (pool->size == 0)
         return;
 
-    byte (*buffer)[pool->block_size] = pool->mem_pool;
-    for (int i = 0; i < pool->size; ++i)
-        **(buffer + i) = 0;
+    // A growable pool keeps only its oldest slab, the rest become empty
+    if (pool->growth != POOL_GROW_NONE)
+    {
+        while (pool->slabs->next)
+            slab_destroy(pool, pool->slabs->next);
+        pool->empty = NULL;
+    }
+
+    /**
+     * Forgetting the free lists and rewinding the high-water marks to the
+     * beginning of each slab releases all the blocks at once.
+     */
+    pool->partial = NULL;
+    for (BlockSlab *slab = pool->slabs; slab; slab = slab->next)
+    {
+        slab_reset(pool, slab);
+        partial_push(pool, slab);
+    }
 
     pool->size = 0;
     LOG_POOL_CLEANUP(pool->mem_pool, pool->capacity);
 }
 
+size_t pool_block_trim(PoolBlock *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    size_t released = 0;
+    for (BlockSlab *slab = pool->slabs; slab; slab = slab->next)
+        released += slab_trim(pool, slab);
+    return released;
+}
+
 void pool_block_destroy(PoolBlock *pool)
 {
     pool_last_error = POOL_OK;
@@ -211,9 +1157,17 @@ void pool_block_destroy(PoolBlock *pool)
         return;
     }
 
-    free(pool->mem_pool);
-    free(pool);
     LOG_POOL_DESTROYED(pool->mem_pool);
+    while (pool->slabs)
+    {
+        BlockSlab *next = pool->slabs->next;
+        pool_registry_remove(pool->slabs->mem, slab_mem_size(pool, pool->slabs->capacity));
+        pool_pages_free(pool->slabs->mem, slab_mem_size(pool, pool->slabs->capacity));
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+    free(pool->generations);
+    free(pool);
 }
 
 size_t pool_block_size(PoolBlock *pool)
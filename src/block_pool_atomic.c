@@ -0,0 +1,263 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pool_errors.h>
+#include <pool_logger.h>
+#include <log_macros.h>
+#include <block_pool_atomic.h>
+
+extern _Thread_local char logger_buffer[256];
+
+// Packing and unpacking of the stack top: index + 1 of the top block and the tag.
+#define HEAD_MAKE(tag, link) (((uint64_t) (tag) << 32) | (uint32_t) (link))
+#define HEAD_LINK(head) ((uint32_t) (head))
+#define HEAD_TAG(head) ((uint32_t) ((head) >> 32))
+
+/**
+ * @brief Returns the header of the block with the given index.
+ */
+static inline _Atomic uint64_t *block_header(const PoolBlockAtomic *pool, size_t index)
+{
+    return (_Atomic uint64_t *) ((byte *) pool->mem_pool + index * pool->block_size);
+}
+
+PoolBlockAtomic *pool_block_atomic_create(size_t capacity, size_t block_size)
+{
+    pool_last_error = POOL_OK;
+    if ((capacity == 0) || (block_size == 0) || (capacity >= UINT32_MAX))
+    {
+        LOG_POOL_INVALID_ARGS;
+        pool_last_error = POOL_INVALID_ARGS;
+        return NULL;
+    }
+
+    PoolBlockAtomic *new_pool = aligned_alloc(CACHE_LINE_SIZE,
+            MULTIPLE_UP(sizeof(PoolBlockAtomic), CACHE_LINE_SIZE));
+    if (!new_pool)
+    {
+        LOG_POOL_CREATE_ERROR(sizeof(PoolBlockAtomic));
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+
+    /**
+     * The block size must be a multiple of the alignment.
+     * We add the alignment value to reserve a header in front of the
+     * payload: it holds the busy marker or the stack link.
+     */
+    size_t mult_block_size = MULTIPLE_UP(block_size, BLOCK_POOL_ALIGNMENT) +
+        BLOCK_POOL_ALIGNMENT;
+
+    new_pool->mem_pool = calloc(capacity, mult_block_size);
+    if (!new_pool->mem_pool)
+    {
+        LOG_POOL_CREATE_ERROR(sizeof(PoolBlockAtomic) + (capacity * block_size));
+        pool_last_error = POOL_ALLOC_FAILED;
+        free(new_pool);
+        return NULL;
+    }
+
+    new_pool->capacity = capacity;
+    new_pool->block_size = mult_block_size;
+    new_pool->offset = BLOCK_POOL_ALIGNMENT;
+    atomic_init(&new_pool->head, HEAD_MAKE(0, 0));
+    atomic_init(&new_pool->untouched, 0);
+    atomic_init(&new_pool->size, 0);
+
+    return new_pool;
+}
+
+/**
+ * @brief Pops the top block from the stack of free blocks.
+ *
+ * @return Index of the block, or capacity if the stack is empty.
+ */
+static size_t stack_pop(PoolBlockAtomic *pool)
+{
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    uint64_t new_head;
+
+    do
+    {
+        if (HEAD_LINK(head) == 0)
+            return pool->capacity;
+
+        /**
+         * The top block may be taken by another thread in the meantime and
+         * its header overwritten. Then the tag has changed and the exchange
+         * below fails, so the value read here is never used.
+         */
+        uint64_t next = atomic_load_explicit(block_header(pool, HEAD_LINK(head) - 1),
+                memory_order_relaxed);
+        new_head = HEAD_MAKE(HEAD_TAG(head) + 1, next);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, new_head,
+                memory_order_acquire, memory_order_acquire));
+
+    return HEAD_LINK(head) - 1;
+}
+
+/**
+ * @brief Pushes the block with the given index on the stack of free blocks.
+ */
+static void stack_push(PoolBlockAtomic *pool, size_t index)
+{
+    _Atomic uint64_t *header = block_header(pool, index);
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+
+    do
+    {
+        atomic_store_explicit(header, HEAD_LINK(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head,
+                HEAD_MAKE(HEAD_TAG(head) + 1, index + 1),
+                memory_order_release, memory_order_relaxed));
+}
+
+void *pool_block_atomic_alloc(PoolBlockAtomic *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return NULL;
+    }
+
+    size_t index = stack_pop(pool);
+
+    // Taking the next untouched block if there are no freed ones
+    if (index == pool->capacity)
+    {
+        index = atomic_load_explicit(&pool->untouched, memory_order_relaxed);
+        do
+        {
+            if (index == pool->capacity)
+            {
+                LOG_POOL_NOT_FREE_SPACE(pool->mem_pool, (size_t) 0, pool->block_size);
+                pool_last_error = POOL_ALLOC_FAILED;
+                return NULL;
+            }
+        } while (!atomic_compare_exchange_weak_explicit(&pool->untouched, &index, index + 1,
+                    memory_order_relaxed, memory_order_relaxed));
+    }
+
+    atomic_store_explicit(block_header(pool, index), ATOMIC_BLOCK_BUSY, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->size, 1, memory_order_relaxed);
+    return (byte *) block_header(pool, index) + pool->offset;
+}
+
+void pool_block_atomic_free(PoolBlockAtomic *pool, void *memblock)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !memblock)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    // Check if the block is within the bounds of the pool's memory.
+    const byte *pool_start = (const byte *) pool->mem_pool + pool->offset;
+    const byte *pool_end = pool_start + (pool->capacity * pool->block_size);
+    if ((const byte *) memblock < pool_start || (const byte *) memblock >= pool_end)
+    {
+        LOG_POOL_ALIEN_PTR(memblock);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+
+    // Check if the block is the start of block in the pool.
+    size_t distance = (const byte *) memblock - pool_start;
+    if (distance % pool->block_size != 0)
+    {
+        LOG_POOL_PTR_NOT_ALIGNMENT(memblock);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+
+    // A block above the watermark is not handed out (a stale free after a cleanup)
+    size_t index = distance / pool->block_size;
+    if (index >= atomic_load_explicit(&pool->untouched, memory_order_relaxed))
+    {
+        LOG_POOL_INVALID_PTR(memblock);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+
+    /**
+     * Only one of the threads freeing the same block wins the exchange,
+     * the others see a double free.
+     */
+    uint64_t busy = ATOMIC_BLOCK_BUSY;
+    if (!atomic_compare_exchange_strong_explicit(block_header(pool, index), &busy, 0,
+                memory_order_relaxed, memory_order_relaxed))
+    {
+        LOG_POOL_INVALID_PTR(memblock);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+
+    atomic_fetch_sub_explicit(&pool->size, 1, memory_order_relaxed);
+    stack_push(pool, index);
+}
+
+void pool_block_atomic_clear(PoolBlockAtomic *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    // The tag keeps growing, so stale tops from before the cleanup never match
+    uint64_t head = atomic_load(&pool->head);
+    atomic_store(&pool->head, HEAD_MAKE(HEAD_TAG(head) + 1, 0));
+    atomic_store(&pool->untouched, 0);
+    atomic_store(&pool->size, 0);
+    LOG_POOL_CLEANUP(pool->mem_pool, pool->capacity);
+}
+
+void pool_block_atomic_destroy(PoolBlockAtomic *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    LOG_POOL_DESTROYED(pool->mem_pool);
+    free(pool->mem_pool);
+    free(pool);
+}
+
+size_t pool_block_atomic_size(PoolBlockAtomic *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    return atomic_load_explicit(&pool->size, memory_order_relaxed);
+}
+
+size_t pool_block_atomic_capacity(PoolBlockAtomic *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    return pool->capacity;
+}
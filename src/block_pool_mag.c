@@ -0,0 +1,418 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <pool_errors.h>
+#include <pool_logger.h>
+#include <log_macros.h>
+#include <block_pool_mag.h>
+
+extern _Thread_local char logger_buffer[256];
+
+/**
+ * @brief Allocates an empty magazine.
+ */
+static BlockMagazine *magazine_create(const PoolBlockMag *pool)
+{
+    BlockMagazine *mag = malloc(sizeof(BlockMagazine) +
+            pool->magazine_size * sizeof(void *));
+    if (mag)
+    {
+        mag->next = NULL;
+        mag->rounds = 0;
+    }
+
+    return mag;
+}
+
+/**
+ * @brief Returns the blocks of the magazine to the backing pool.
+ *
+ * The depot lock must be held by the caller.
+ */
+static void magazine_drain(PoolBlockMag *pool, BlockMagazine *mag)
+{
+    pool_block_free_n(pool->pool, mag->blocks, mag->rounds);
+    mag->rounds = 0;
+}
+
+/**
+ * @brief Publishes the number of blocks cached by the thread.
+ *
+ * Only the thread owning the cache writes it, pool_block_mag_size reads it.
+ * The exchanges with the depot publish it under the lock, so the magazines
+ * moved are never counted twice.
+ */
+static inline void cache_count(MagCache *cache)
+{
+    atomic_store_explicit(&cache->cached, cache->loaded->rounds + cache->previous->rounds,
+            memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the magazines of the thread to the depot and frees the cache.
+ *
+ * Called on thread exit. Partially filled magazines cannot be put on the
+ * list of full ones, so their blocks go back to the backing pool.
+ */
+static void cache_release(void *arg)
+{
+    MagCache *cache = arg;
+    PoolBlockMag *pool = cache->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    BlockMagazine *mags[] = {cache->loaded, cache->previous};
+    for (int i = 0; i < 2; ++i)
+    {
+        if (mags[i]->rounds == pool->magazine_size)
+        {
+            mags[i]->next = pool->full;
+            pool->full = mags[i];
+            continue;
+        }
+
+        magazine_drain(pool, mags[i]);
+        mags[i]->next = pool->empty;
+        pool->empty = mags[i];
+    }
+
+    if (cache->prev)
+        cache->prev->next = cache->next;
+    else
+        pool->caches = cache->next;
+    if (cache->next)
+        cache->next->prev = cache->prev;
+    pthread_mutex_unlock(&pool->lock);
+
+    free(cache);
+}
+
+/**
+ * @brief Creates the cache of the calling thread.
+ *
+ * The cache is aligned to the cache line, so the caches of different
+ * threads never share a line.
+ */
+static MagCache *cache_create(PoolBlockMag *pool)
+{
+    size_t size = MULTIPLE_UP(sizeof(MagCache), CACHE_LINE_SIZE);
+    MagCache *cache = aligned_alloc(CACHE_LINE_SIZE, size);
+    if (!cache)
+        return NULL;
+
+    cache->pool = pool;
+    atomic_init(&cache->cached, 0);
+    cache->loaded = magazine_create(pool);
+    cache->previous = magazine_create(pool);
+    if (!cache->loaded || !cache->previous ||
+            pthread_setspecific(pool->key, cache) != 0)
+    {
+        free(cache->loaded);
+        free(cache->previous);
+        free(cache);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    cache->prev = NULL;
+    cache->next = pool->caches;
+    if (pool->caches)
+        pool->caches->prev = cache;
+    pool->caches = cache;
+    pthread_mutex_unlock(&pool->lock);
+
+    return cache;
+}
+
+/**
+ * @brief Returns the cache of the calling thread, creates it on first use.
+ */
+static inline MagCache *cache_get(PoolBlockMag *pool)
+{
+    MagCache *cache = pthread_getspecific(pool->key);
+    if (!cache)
+        cache = cache_create(pool);
+
+    return cache;
+}
+
+/**
+ * @brief Loads a magazine with blocks when both magazines of the cache are empty.
+ *
+ * The empty loaded magazine is exchanged for a full one from the depot.
+ * If the depot has no full magazines, the loaded magazine is filled from
+ * the backing pool.
+ *
+ * @return 'true' if the loaded magazine has blocks, otherwise 'false'.
+ */
+static bool depot_load(PoolBlockMag *pool, MagCache *cache)
+{
+    pthread_mutex_lock(&pool->lock);
+    BlockMagazine *mag = pool->full;
+    if (mag)
+    {
+        pool->full = mag->next;
+        cache->loaded->next = pool->empty;
+        pool->empty = cache->loaded;
+        cache->loaded = mag;
+    }
+    else
+    {
+        mag = cache->loaded;
+        mag->rounds += pool_block_alloc_n(pool->pool, mag->blocks + mag->rounds,
+                pool->magazine_size - mag->rounds);
+    }
+    cache_count(cache);
+    pthread_mutex_unlock(&pool->lock);
+
+    return cache->loaded->rounds > 0;
+}
+
+/**
+ * @brief Unloads a full magazine when both magazines of the cache are full.
+ *
+ * The full previous magazine goes to the depot, the loaded one takes its
+ * place and an empty magazine is loaded. If there are no empty magazines
+ * in the depot, a new one is allocated. If that fails as well, the blocks
+ * of the loaded magazine are returned to the backing pool.
+ */
+static void depot_unload(PoolBlockMag *pool, MagCache *cache)
+{
+    pthread_mutex_lock(&pool->lock);
+    BlockMagazine *mag = pool->empty;
+    if (mag)
+        pool->empty = mag->next;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!mag)
+        mag = magazine_create(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    if (mag)
+    {
+        cache->previous->next = pool->full;
+        pool->full = cache->previous;
+        cache->previous = cache->loaded;
+        cache->loaded = mag;
+    }
+    else
+        magazine_drain(pool, cache->loaded);
+    cache_count(cache);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Swaps the loaded and the previous magazines of the cache.
+ */
+static inline void cache_swap(MagCache *cache)
+{
+    BlockMagazine *tmp = cache->loaded;
+    cache->loaded = cache->previous;
+    cache->previous = tmp;
+}
+
+PoolBlockMag *pool_block_mag_create(size_t capacity, size_t block_size,
+        size_t magazine_size)
+{
+    pool_last_error = POOL_OK;
+    PoolBlockMag *new_pool = aligned_alloc(CACHE_LINE_SIZE,
+            MULTIPLE_UP(sizeof(PoolBlockMag), CACHE_LINE_SIZE));
+    if (!new_pool)
+    {
+        LOG_POOL_CREATE_ERROR(sizeof(PoolBlockMag));
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+
+    // Also validates the arguments
+    new_pool->pool = pool_block_create(capacity, block_size);
+    if (!new_pool->pool)
+    {
+        free(new_pool);
+        return NULL;
+    }
+
+    if (pthread_key_create(&new_pool->key, cache_release) != 0)
+    {
+        LOG_POOL_CREATE_ERROR(sizeof(PoolBlockMag));
+        pool_last_error = POOL_CREATE_FAILED;
+        pool_block_destroy(new_pool->pool);
+        free(new_pool);
+        return NULL;
+    }
+
+    // The backing pool does not grow, its only slab stays in place
+    const BlockSlab *slab = new_pool->pool->slabs;
+    new_pool->block_size = new_pool->pool->block_size;
+    new_pool->first = (const byte *) slab->mem + new_pool->pool->offset;
+    new_pool->end = new_pool->first + slab->capacity * new_pool->block_size;
+
+    pthread_mutex_init(&new_pool->lock, NULL);
+    new_pool->magazine_size = magazine_size ? magazine_size : DEFAULT_MAGAZINE_SIZE;
+    new_pool->full = NULL;
+    new_pool->empty = NULL;
+    new_pool->caches = NULL;
+
+    return new_pool;
+}
+
+void *pool_block_mag_alloc(PoolBlockMag *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return NULL;
+    }
+
+    MagCache *cache = cache_get(pool);
+    if (!cache)
+    {
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+
+    if (cache->loaded->rounds == 0)
+    {
+        if (cache->previous->rounds > 0)
+            cache_swap(cache);
+        else if (!depot_load(pool, cache))
+        {
+            LOG_POOL_NOT_FREE_SPACE(pool, (size_t) 0, pool->block_size);
+            pool_last_error = POOL_ALLOC_FAILED;
+            return NULL;
+        }
+    }
+
+    // Refilling from the backing pool may have left an error behind
+    pool_last_error = POOL_OK;
+    void *block = cache->loaded->blocks[--cache->loaded->rounds];
+    cache_count(cache);
+    return block;
+}
+
+void pool_block_mag_free(PoolBlockMag *pool, void *memblock)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !memblock)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    // Only the copied bounds are read, they never change
+    const byte *block = memblock;
+    if (block < pool->first || block >= pool->end)
+    {
+        LOG_POOL_ALIEN_PTR(memblock);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+    if ((size_t) (block - pool->first) % pool->block_size != 0)
+    {
+        LOG_POOL_PTR_NOT_ALIGNMENT(memblock);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+
+    MagCache *cache = cache_get(pool);
+    if (!cache)
+    {
+        // Without a cache the block goes straight back to the backing pool
+        pthread_mutex_lock(&pool->lock);
+        pool_block_free(pool->pool, memblock);
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    if (cache->loaded->rounds == pool->magazine_size)
+    {
+        if (cache->previous->rounds < pool->magazine_size)
+            cache_swap(cache);
+        else
+            depot_unload(pool, cache);
+    }
+
+    cache->loaded->blocks[cache->loaded->rounds++] = memblock;
+    cache_count(cache);
+}
+
+void pool_block_mag_destroy(PoolBlockMag *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    // Destructors of the remaining threads must not touch the pool anymore
+    pthread_key_delete(pool->key);
+
+    while (pool->caches)
+    {
+        MagCache *next = pool->caches->next;
+        free(pool->caches->loaded);
+        free(pool->caches->previous);
+        free(pool->caches);
+        pool->caches = next;
+    }
+
+    BlockMagazine *lists[] = {pool->full, pool->empty};
+    for (int i = 0; i < 2; ++i)
+    {
+        while (lists[i])
+        {
+            BlockMagazine *next = lists[i]->next;
+            free(lists[i]);
+            lists[i] = next;
+        }
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pool_block_destroy(pool->pool);
+    free(pool);
+}
+
+size_t pool_block_mag_size(PoolBlockMag *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    /**
+     * Blocks cached in the magazines are busy for the backing pool. A block
+     * moving between two threads may be seen in both caches for a moment.
+     */
+    pthread_mutex_lock(&pool->lock);
+    size_t size = pool->pool->size;
+    size_t cached = 0;
+    for (BlockMagazine *mag = pool->full; mag; mag = mag->next)
+        cached += mag->rounds;
+    for (MagCache *cache = pool->caches; cache; cache = cache->next)
+        cached += atomic_load_explicit(&cache->cached, memory_order_relaxed);
+    pthread_mutex_unlock(&pool->lock);
+
+    return (cached < size) ? size - cached : 0;
+}
+
+size_t pool_block_mag_capacity(PoolBlockMag *pool)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return 0;
+    }
+
+    return pool->pool->capacity;
+}
@@ -3,103 +3,1307 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <dynamic_pool.h>
 #include <pool_errors.h>
 #include <logger.h>
 #include <log_macros.h>
+#include <pool_registry.h>
+#include <pool_pages.h>
+
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#if !defined(__ARM_FEATURE_CRC32) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#endif
 
 // Buffer for logger
-extern char logger_buffer[256];
+extern _Thread_local char logger_buffer[256];
+
+/**
+ * Index of the highest set bit of a non-zero value.
+ */
+#define HIGH_BIT(value) (63 - __builtin_clzll((unsigned long long) (value)))
+
+/**
+ * Links of a free list, kept in the payload of a free block (POOL_DYN_TLSF).
+ */
+typedef struct dyn_free_links {
+    void *prev;
+    void *next;
+} DynFreeLinks;
+
+/**
+ * The functions below take the header of a block as void * and work with
+ * both header layouts.
+ */
+static inline bool is_compact(const PoolDyn *pool)
+{
+    return pool->flags & POOL_DYN_COMPACT;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const uint64_t *words, size_t count)
+{
+    uint64_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < count; ++i)
+        crc = __builtin_ia32_crc32di(crc, words[i]);
+    return ~(uint32_t) crc;
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32c_arm(const uint64_t *words, size_t count)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < count; ++i)
+        crc = __crc32cd(crc, words[i]);
+    return ~crc;
+}
+#endif
+
+/**
+ * CRC32C of every byte value (reflected polynomial 0x82F63B78), for the
+ * processors without the instruction.
+ */
+static const uint32_t crc32c_table[256] = {
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+    0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+    0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+    0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+    0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+    0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+    0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+    0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+    0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+    0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+    0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+    0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+    0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+    0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+    0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+    0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+    0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+    0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+    0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+    0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+    0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+    0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+    0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+    0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+    0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+    0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+    0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+    0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+    0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+    0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+    0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+    0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+    0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
+};
+
+/**
+ * @brief Returns the CRC32C of the words.
+ *
+ * The processor instruction is used where the processor supports it,
+ * which is checked at run time unless the build already requires it.
+ */
+static uint32_t crc32c(const uint64_t *words, size_t count)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2"))
+        return crc32c_sse42(words, count);
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    return crc32c_arm(words, count);
+#elif defined(__aarch64__) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+        return crc32c_arm(words, count);
+#endif
+
+    uint32_t crc = 0xFFFFFFFF;
+    const unsigned char *bytes = (const unsigned char *) words;
+    for (size_t i = 0; i < count * sizeof(uint64_t); ++i)
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ bytes[i]) & 0xFF];
+    return ~crc;
+}
+
+_Static_assert(sizeof(MetaData) == 4 * sizeof(uint64_t), "MetaData is checksummed by words");
+
+/**
+ * @brief Returns the checksum of the header fields but the end canary.
+ */
+static inline uint32_t header_checksum(const MetaData *meta)
+{
+    MetaData header = *meta;
+    header.end_canary = 0;
+
+    uint64_t words[4];
+    memcpy(words, &header, sizeof(words));
+    return crc32c(words, 4);
+}
+
+/**
+ * @brief Updates the checksum of a changed header (POOL_DYN_INTEGRITY_CHECKSUM).
+ */
+static inline void seal(const PoolDyn *pool, MetaData *meta)
+{
+    if (pool->integrity == POOL_DYN_INTEGRITY_CHECKSUM)
+        meta->end_canary = header_checksum(meta);
+}
+
+/**
+ * @brief Checks the header according to the integrity level of the pool.
+ */
+static inline bool header_intact(const PoolDyn *pool, const MetaData *meta)
+{
+    if (meta->canary != CANARY_FREE && meta->canary != CANARY_USED)
+        return false;
+
+    switch (pool->integrity)
+    {
+    case POOL_DYN_INTEGRITY_NONE:
+        return true;
+    case POOL_DYN_INTEGRITY_CHECKSUM:
+        return meta->end_canary == header_checksum(meta);
+    default:
+        return meta->end_canary == END_CANARY;
+    }
+}
+
+/**
+ * @brief Tells whether the header of a block being used is damaged.
+ *
+ * With the canaries only the first one is compared, the second one is
+ * left to restore_block.
+ */
+static inline bool header_damaged(const PoolDyn *pool, const MetaData *meta)
+{
+    switch (pool->integrity)
+    {
+    case POOL_DYN_INTEGRITY_NONE:
+        return false;
+    case POOL_DYN_INTEGRITY_CHECKSUM:
+        return !header_intact(pool, meta);
+    default:
+        return meta->canary != CANARY_FREE && meta->canary != CANARY_USED;
+    }
+}
+
+static inline size_t block_size(const PoolDyn *pool, const void *block)
+{
+    return is_compact(pool) ? *(const DynHeader *) block & DYN_SIZE_MASK :
+        ((const MetaData *) block)->size;
+}
+
+static inline void set_block_size(const PoolDyn *pool, void *block, size_t size)
+{
+    if (is_compact(pool))
+        *(DynHeader *) block = (*(DynHeader *) block & ~DYN_SIZE_MASK) | size;
+    else
+        ((MetaData *) block)->size = size;
+}
+
+/**
+ * @brief Returns the header of the next block, NULL for the last block.
+ */
+static inline void *block_next(const PoolDyn *pool, void *block)
+{
+    if (!is_compact(pool))
+        return ((MetaData *) block)->next_block;
+
+    void *next = block + sizeof(DynHeader) + block_size(pool, block);
+    return (next < pool->mem_pool + pool->capacity) ? next : NULL;
+}
+
+/**
+ * @brief Checks that the block is free and its metadata is intact.
+ */
+static inline bool block_is_free(const PoolDyn *pool, const void *block)
+{
+    if (is_compact(pool))
+        return *(const DynHeader *) block & DYN_BLOCK_FREE;
+
+    const MetaData *meta = block;
+    return meta->canary == CANARY_FREE && header_intact(pool, meta);
+}
+
+/**
+ * @brief Returns the header of the block in front of the block if it is
+ * free, NULL otherwise.
+ */
+static inline void *block_prev_free(const PoolDyn *pool, void *block)
+{
+    if (is_compact(pool))
+    {
+        if (!(*(DynHeader *) block & DYN_PREV_FREE))
+            return NULL;
+        // The size of the free block is repeated at the end of its payload
+        return block - *(DynHeader *) (block - sizeof(DynHeader)) - sizeof(DynHeader);
+    }
+
+    MetaData *prev = ((MetaData *) block)->prev_block;
+    return (prev && block_is_free(pool, prev)) ? prev : NULL;
+}
+
+/**
+ * @brief Sets the busy flag of the block to free.
+ */
+static inline void set_free(const PoolDyn *pool, void *block)
+{
+    if (is_compact(pool))
+        *(DynHeader *) block |= DYN_BLOCK_FREE;
+    else
+    {
+        ((MetaData *) block)->canary = CANARY_FREE;
+        seal(pool, block);
+    }
+}
+
+/**
+ * @brief Marks the block free, a compact block also writes its size to
+ * the end of the payload and tells the next block about it.
+ */
+static inline void mark_free(const PoolDyn *pool, void *block)
+{
+    set_free(pool, block);
+    if (!is_compact(pool))
+        return;
+
+    size_t size = block_size(pool, block);
+    *(DynHeader *) (block + size) = size;
+    DynHeader *next = block_next(pool, block);
+    if (next)
+        *next |= DYN_PREV_FREE;
+}
+
+static inline void mark_used(const PoolDyn *pool, void *block)
+{
+    if (!is_compact(pool))
+    {
+        ((MetaData *) block)->canary = CANARY_USED;
+        seal(pool, block);
+        return;
+    }
+
+    *(DynHeader *) block &= ~(DynHeader) DYN_BLOCK_FREE;
+    DynHeader *next = block_next(pool, block);
+    if (next)
+        *next &= ~(DynHeader) DYN_PREV_FREE;
+}
+
+static inline DynFreeLinks *free_links(const PoolDyn *pool, void *block)
+{
+    return block + pool->header_size;
+}
+
+/**
+ * @brief Tells whether a free block was dropped from the index.
+ *
+ * tlsf_take links a dropped block to itself, which no block in a list
+ * can be. A dropped block is still counted in the statistics.
+ */
+static inline bool tlsf_dropped(const PoolDyn *pool, void *block)
+{
+    const DynFreeLinks *links = free_links(pool, block);
+    return links->prev == block && links->next == block;
+}
+
+/**
+ * @brief Returns the free list of the blocks of the given size.
+ */
+static inline void tlsf_mapping(size_t size, unsigned int *fl, unsigned int *sl)
+{
+    unsigned int high = HIGH_BIT(size);
+    *fl = high;
+    *sl = (size >> (high - DYN_TLSF_SL_BITS)) ^ DYN_TLSF_SL_COUNT;
+}
+
+static void tlsf_insert(PoolDyn *pool, void *block)
+{
+    DynTlsf *tlsf = pool->tlsf;
+    unsigned int fl, sl;
+    tlsf_mapping(block_size(pool, block), &fl, &sl);
+
+    DynFreeLinks *links = free_links(pool, block);
+    links->prev = NULL;
+    links->next = tlsf->heads[fl][sl];
+    if (links->next)
+        free_links(pool, links->next)->prev = block;
+    tlsf->heads[fl][sl] = block;
+    tlsf->fl_bitmap |= (uint64_t) 1 << fl;
+    tlsf->sl_bitmap[fl] |= (uint32_t) 1 << sl;
+}
+
+static void tlsf_remove(PoolDyn *pool, void *block)
+{
+    DynTlsf *tlsf = pool->tlsf;
+    unsigned int fl, sl;
+    tlsf_mapping(block_size(pool, block), &fl, &sl);
+
+    DynFreeLinks *links = free_links(pool, block);
+    if (links->next)
+        free_links(pool, links->next)->prev = links->prev;
+    if (links->prev)
+        free_links(pool, links->prev)->next = links->next;
+    else
+    {
+        tlsf->heads[fl][sl] = links->next;
+        if (!links->next)
+        {
+            tlsf->sl_bitmap[fl] &= ~((uint32_t) 1 << sl);
+            if (!tlsf->sl_bitmap[fl])
+                tlsf->fl_bitmap &= ~((uint64_t) 1 << fl);
+        }
+    }
+}
+
+/**
+ * @brief Finds a free block of at least the given size.
+ *
+ * The size is rounded up to the next list boundary, so any block of the
+ * list found is large enough and no list has to be searched. If there is
+ * no such list, only the first block of the list of the size itself is
+ * checked (it serves the requests for all the remaining space).
+ */
+static void *tlsf_find(const PoolDyn *pool, size_t size)
+{
+    const DynTlsf *tlsf = pool->tlsf;
+    unsigned int fl, sl;
+    tlsf_mapping(size + ((size_t) 1 << (HIGH_BIT(size) - DYN_TLSF_SL_BITS)) - 1, &fl, &sl);
+
+    uint32_t sl_map = (fl < DYN_TLSF_FL_COUNT) ?
+        tlsf->sl_bitmap[fl] & (~(uint32_t) 0 << sl) : 0;
+    if (!sl_map)
+    {
+        uint64_t fl_map = (fl + 1 < DYN_TLSF_FL_COUNT) ?
+            tlsf->fl_bitmap & (~(uint64_t) 0 << (fl + 1)) : 0;
+        if (!fl_map)
+        {
+            tlsf_mapping(size, &fl, &sl);
+            void *block = (fl < DYN_TLSF_FL_COUNT) ? tlsf->heads[fl][sl] : NULL;
+            return (block && block_size(pool, block) >= size) ? block : NULL;
+        }
+
+        fl = __builtin_ctzll(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+
+    return tlsf->heads[fl][__builtin_ctz(sl_map)];
+}
+
+/**
+ * @brief Tells whether the bucket holds a single free block and all the
+ * other free blocks are in lower buckets.
+ *
+ * No bucket above the one of the largest size (or its upper bound) is
+ * occupied, so only the buckets up to it are checked.
+ */
+static inline bool stats_top_single(const PoolDynStats *stats, unsigned int bucket)
+{
+    if (stats->histogram[bucket] != 1)
+        return false;
+    for (unsigned int i = HIGH_BIT(stats->largest_free); i > bucket; --i)
+        if (stats->histogram[i])
+            return false;
+    return true;
+}
+
+/**
+ * @brief Accounts for a free block of the given size in the statistics.
+ *
+ * A block at least as large as the upper bound, or alone in the highest
+ * bucket (the remainder of a split largest block), is the largest one.
+ */
+static inline void stats_add(PoolDyn *pool, size_t size)
+{
+    PoolDynStats *stats = &pool->stats;
+    unsigned int bucket = HIGH_BIT(size);
+    ++stats->free_blocks;
+    stats->free_bytes += size;
+    ++stats->histogram[bucket];
+
+    if (pool->largest_exact && size == stats->largest_free)
+        ++pool->largest_count;
+    else if (size > stats->largest_free ||
+            (!pool->largest_exact && (size == stats->largest_free ||
+            stats_top_single(stats, bucket))))
+    {
+        stats->largest_free = size;
+        pool->largest_count = 1;
+        pool->largest_exact = true;
+    }
+}
+
+/**
+ * @brief Removes a free block of the given size from the statistics.
+ *
+ * Without the last block of the largest size the largest size is only an
+ * upper bound, it is found again when needed (largest_refresh).
+ */
+static inline void stats_sub(PoolDyn *pool, size_t size)
+{
+    PoolDynStats *stats = &pool->stats;
+    --stats->free_blocks;
+    stats->free_bytes -= size;
+    --stats->histogram[HIGH_BIT(size)];
+    if (!stats->free_blocks)
+    {
+        stats->largest_free = 0;
+        pool->largest_count = 0;
+        pool->largest_exact = true;
+    }
+    else if (pool->largest_exact && size == stats->largest_free && !--pool->largest_count)
+        pool->largest_exact = false;
+}
+
+/**
+ * @brief Adds a free block to the index (if any) and the statistics.
+ */
+static inline void free_insert(PoolDyn *pool, void *block)
+{
+    stats_add(pool, block_size(pool, block));
+    if (pool->tlsf)
+        tlsf_insert(pool, block);
+}
+
+/**
+ * @brief Removes a free block from the index (if any) and the statistics.
+ */
+static inline void free_remove(PoolDyn *pool, void *block)
+{
+    stats_sub(pool, block_size(pool, block));
+    if (pool->tlsf && !tlsf_dropped(pool, block))
+        tlsf_remove(pool, block);
+}
+
+/**
+ * @brief Finds the exact size of the largest free block.
+ *
+ * With the index only the highest non-empty list is searched, otherwise
+ * all the blocks are walked.
+ */
+static void largest_refresh(PoolDyn *pool)
+{
+    size_t largest = 0, count = 0;
+    void *block = NULL;
+    if (pool->tlsf && pool->tlsf->fl_bitmap)
+    {
+        // The blocks of the same size are in the same list
+        const DynTlsf *tlsf = pool->tlsf;
+        unsigned int fl = HIGH_BIT(tlsf->fl_bitmap);
+        block = tlsf->heads[fl][HIGH_BIT(tlsf->sl_bitmap[fl])];
+    }
+    else if (!pool->tlsf)
+        block = pool->mem_pool;
+
+    for (; block; block = pool->tlsf ? free_links(pool, block)->next : block_next(pool, block))
+    {
+        size_t size = block_size(pool, block);
+        if (size < largest || (!pool->tlsf && !block_is_free(pool, block)))
+            continue;
+        count = (size == largest) ? count + 1 : 1;
+        largest = size;
+    }
+
+    pool->stats.largest_free = largest;
+    pool->largest_count = count;
+    pool->largest_exact = true;
+}
+
+/**
+ * @brief Appends the next block to the block.
+ */
+static inline void absorb_next(PoolDyn *pool, void *block, void *next)
+{
+    set_block_size(pool, block, block_size(pool, block) + pool->header_size +
+            block_size(pool, next));
+    if (!is_compact(pool))
+    {
+        MetaData *meta = block, *next_meta = next;
+        meta->next_block = next_meta->next_block;
+        seal(pool, meta);
+        if (next_meta->next_block)
+        {
+            next_meta->next_block->prev_block = meta;
+            seal(pool, next_meta->next_block);
+        }
+    }
+    pool->size -= pool->header_size;
+
+    // The coalescing step resumes from the block that took the cursor
+    if (next == pool->coalesce_cursor)
+        pool->coalesce_cursor = block;
+}
+
+/**
+ * @brief Merges a released block with its free neighbours.
+ * @return The header of the merged block.
+ */
+static void *merge_neighbours(PoolDyn *pool, void *block)
+{
+    void *next = block_next(pool, block);
+    if (next && block_is_free(pool, next))
+    {
+        free_remove(pool, next);
+        absorb_next(pool, block, next);
+    }
+
+    void *prev = block_prev_free(pool, block);
+    if (prev)
+    {
+        free_remove(pool, prev);
+        absorb_next(pool, prev, block);
+        block = prev;
+    }
+
+    return block;
+}
+
+/**
+ * @brief Rebuilds the index and the statistics from the list of all blocks.
+ */
+static void free_rebuild(PoolDyn *pool)
+{
+    if (pool->tlsf)
+        memset(pool->tlsf, 0, sizeof(DynTlsf));
+    memset(&pool->stats, 0, sizeof(PoolDynStats));
+    pool->largest_count = 0;
+    pool->largest_exact = true;
+    for (void *block = pool->mem_pool; block; block = block_next(pool, block))
+        if (block_is_free(pool, block))
+            free_insert(pool, block);
+}
+
+/**
+ * @brief Turns the whole pool into one free block.
+ */
+static void reset_blocks(PoolDyn *pool)
+{
+    void *block = pool->mem_pool;
+    if (is_compact(pool))
+        *(DynHeader *) block = 0;
+    else
+    {
+        MetaData *block_meta = block;
+        block_meta->next_block = NULL;
+        block_meta->prev_block = NULL;
+        block_meta->end_canary = END_CANARY;
+    }
+
+    set_block_size(pool, block, pool->capacity - pool->header_size);
+    mark_free(pool, block);
+    pool->size = pool->header_size;
+    pool->coalesce_cursor = NULL;
+    free_rebuild(pool);
+}
+
+/**
+ * @brief Returns the size of the mapping holding the given amount of pool memory.
+ */
+static size_t mapping_size(unsigned int flags, size_t size)
+{
+    size_t page = (flags & POOL_DYN_HUGE_PAGES) ? POOL_PAGES_HUGE_SIZE : REGISTRY_PAGE_SIZE;
+    return MULTIPLICITY_UP(size, page);
+}
 
 PoolDyn *pool_dyn_create(size_t capacity)
 {
-    pool_last_error = POOL_OK;
+    return pool_dyn_create_ex(capacity, NULL);
+}
+
+PoolDyn *pool_dyn_create_aligned(size_t capacity, size_t alignment)
+{
+    PoolDynOptions options = { .flags = 0, .alignment = alignment };
+    return pool_dyn_create_ex(capacity, &options);
+}
+
+/**
+ * @brief Creates an arena of the given capacity with validated options.
+ *
+ * The capacity of a growable pool's arena takes the rest of its last page,
+ * a fixed one is kept as it was requested.
+ */
+static PoolDyn *arena_create(size_t capacity, const PoolDynOptions *options)
+{
+    unsigned int flags = options->flags;
+    bool tlsf = flags & POOL_DYN_TLSF;
     PoolDyn *new_pool = calloc(1, sizeof(PoolDyn));
     if (!new_pool)
     {
-        LOG_POOL_CREATE_ERROR(sizeof(PoolDyn));
-        pool_last_error = POOL_CREATE_FAILED;
+        LOG_POOL_CREATE_ERROR(sizeof(PoolDyn));
+        pool_last_error = POOL_CREATE_FAILED;
+        return NULL;
+    }
+
+    /**
+     * A free compact block keeps its size at the end of the payload,
+     * behind the links of its free list (if any).
+     */
+    new_pool->flags = flags;
+    new_pool->integrity = options->integrity;
+    if (flags & POOL_DYN_COMPACT)
+    {
+        new_pool->header_size = sizeof(DynHeader);
+        new_pool->min_block = tlsf ? DYN_TLSF_MIN_SIZE + sizeof(DynHeader) : MIN_ALLOC_SIZE;
+    }
+    else
+    {
+        new_pool->header_size = sizeof(MetaData);
+        new_pool->min_block = tlsf ? DYN_TLSF_MIN_SIZE : MIN_ALLOC_SIZE;
+    }
+
+    // The pool holds at least one block of the minimum size
+    size_t alignment = options->alignment;
+    size_t final_capacity = MULTIPLICITY_UP(capacity, MIN_ALLOC_SIZE);
+    if (final_capacity < capacity)
+        final_capacity = MULTIPLICITY_DOWN(capacity, MIN_ALLOC_SIZE);
+    size_t min_capacity = new_pool->header_size + new_pool->min_block;
+    if (final_capacity < min_capacity)
+        final_capacity = min_capacity;
+
+    /**
+     * The first header is placed so that the payload behind it is aligned.
+     * Block sizes are kept such that every next payload is aligned too,
+     * which needs the capacity to be a multiple of the alignment.
+     */
+    size_t lead = MULTIPLICITY_UP(new_pool->header_size, alignment) - new_pool->header_size;
+    final_capacity = MULTIPLICITY_UP(final_capacity, alignment);
+
+    /**
+     * The pool occupies whole pages, so it can be registered as the only
+     * owner of its pages in the pool registry.
+     */
+    size_t raw_size = mapping_size(flags, lead + final_capacity);
+    if (options->growth != POOL_DYN_GROW_NONE)
+        final_capacity = MULTIPLICITY_DOWN(raw_size - lead, alignment);
+
+    void *raw = (flags & POOL_DYN_HUGE_PAGES) ? pool_pages_alloc_huge(raw_size, &new_pool->pages) :
+        pool_pages_alloc(raw_size);
+    if (tlsf)
+        new_pool->tlsf = calloc(1, sizeof(DynTlsf));
+    if (!raw || (tlsf && !new_pool->tlsf) ||
+            !pool_registry_add(raw, raw_size, new_pool, POOL_KIND_DYN))
+    {
+        LOG_POOL_CREATE_ERROR(sizeof(PoolDyn));
+        pool_last_error = POOL_CREATE_FAILED;
+        pool_pages_free(raw, raw_size);
+        free(new_pool->tlsf);
+        free(new_pool);
+        return NULL;
+    }
+
+    void *mem_pool = raw + lead;
+
+    new_pool->raw = raw;
+    new_pool->mem_pool = mem_pool;
+    new_pool->capacity = final_capacity;
+    new_pool->alignment = alignment;
+    new_pool->zeroed = mem_pool + new_pool->header_size + DYN_TLSF_MIN_SIZE;
+    new_pool->pool = new_pool;
+    new_pool->trim_threshold = options->trim_threshold;
+
+    // Empty pool is one big block
+    reset_blocks(new_pool);
+    LOG_POOL_CREATE_INFO(final_capacity, MIN_ALLOC_SIZE, (void *) raw);
+
+    return new_pool;
+}
+
+/**
+ * @brief Unmaps the memory of an arena and frees its structure.
+ */
+static void arena_free(PoolDyn *arena)
+{
+    LOG_POOL_DESTROYED(arena->mem_pool);
+    size_t raw_size = mapping_size(arena->flags,
+            (size_t) (arena->mem_pool - arena->raw) + arena->capacity);
+    pool_registry_remove(arena->raw, raw_size);
+    pool_pages_free(arena->raw, raw_size);
+    free(arena->tlsf);
+    free(arena);
+}
+
+PoolDyn *pool_dyn_create_ex(size_t capacity, const PoolDynOptions *options)
+{
+    pool_last_error = POOL_OK;
+    PoolDynOptions checked = {
+        .flags = options ? options->flags : 0,
+        .alignment = (options && options->alignment) ? options->alignment : ALIGNMENT,
+        .integrity = options ? options->integrity : POOL_DYN_INTEGRITY_DEFAULT,
+        .growth = options ? options->growth : POOL_DYN_GROW_NONE,
+        .growth_step = options ? options->growth_step : 0,
+        .trim_threshold = options ? options->trim_threshold : 0,
+    };
+    size_t alignment = checked.alignment;
+    if (alignment < ALIGNMENT || alignment > DYN_MAX_ALIGNMENT ||
+            (alignment & (alignment - 1)) || checked.integrity > POOL_DYN_INTEGRITY_CHECKSUM ||
+            ((checked.flags & POOL_DYN_COMPACT) && checked.integrity > POOL_DYN_INTEGRITY_NONE) ||
+            checked.growth > POOL_DYN_GROW_FIXED ||
+            (checked.growth == POOL_DYN_GROW_FIXED && !checked.growth_step))
+    {
+        LOG_POOL_INVALID_ARGS;
+        pool_last_error = POOL_INVALID_ARGS;
+        return NULL;
+    }
+
+    if (checked.flags & POOL_DYN_COMPACT)
+        checked.integrity = POOL_DYN_INTEGRITY_NONE;
+    else if (!checked.integrity)
+        checked.integrity = POOL_DYN_DEFAULT_INTEGRITY;
+
+    /**
+     * We compensate for the memory occupied by metadata
+     * by default, 30% more memory is allocated.
+     * A growable pool adds arenas instead, it is sized exactly.
+     */
+    size_t final_capacity = capacity;
+    if (checked.growth == POOL_DYN_GROW_NONE)
+    {
+        final_capacity = (size_t) (capacity * ADVANCE);
+
+        /**
+         * Overflow check
+         * We don't allocate more memory (in bytes) than the
+         * maximum value of the size_t type.
+         */
+        if (final_capacity < capacity)
+            final_capacity = capacity;
+    }
+
+    PoolDyn *new_pool = arena_create(final_capacity, &checked);
+    if (new_pool)
+    {
+        new_pool->growth = checked.growth;
+        new_pool->growth_step = checked.growth_step;
+    }
+    return new_pool;
+}
+
+/**
+ * @brief Finds and returns the next block in the pool
+ * @param pool Pointer to the pool
+ * @param block Initial block
+ * @return Pointer to the next block
+ */
+void *find_next_block(PoolDyn *pool, void *block)
+{
+    MetaData *reference_block = pool->mem_pool;
+    size_t canary_size = sizeof(reference_block->canary);   // Pool advancement step
+
+    /**
+     * If we get to this point there is no point in continuing. Either all the
+     * subsequent blocks we are looking for are corrupted, or the initial block is
+     * the last block in the pool.
+     */
+    void *stop_byte = pool->mem_pool + pool->capacity - MIN_ALLOC_SIZE;
+    MetaData *desired_block = block + canary_size;
+
+    while ((uintptr_t) desired_block > (uintptr_t) stop_byte)
+    {
+        if ((desired_block->canary == CANARY_FREE || desired_block->canary == CANARY_USED) &&
+                desired_block->end_canary == END_CANARY)
+        {
+            return desired_block;
+        }
+        desired_block = (void *) desired_block + canary_size;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Returns the distance from the payload of a free block to the
+ * first payload aligned to the given alignment.
+ *
+ * A non-zero distance always leaves room for a free block of the minimum
+ * size in front of the aligned payload, the gap is not wasted.
+ */
+static size_t aligned_gap(const PoolDyn *pool, const void *block, size_t alignment)
+{
+    uintptr_t payload = (uintptr_t) block + pool->header_size;
+    if (payload % alignment == 0)
+        return 0;
+
+    return MULTIPLICITY_UP(payload + pool->header_size + pool->min_block, alignment) - payload;
+}
+
+/**
+ * @brief Finds the first free block holding an aligned payload of suitable
+ * size in the list of all blocks.
+ */
+static void *first_fit(PoolDyn *pool, size_t alloc_size, size_t alignment)
+{
+    void *block = pool->mem_pool;
+    while (block)
+    {
+        // The header is checked only for the blocks large enough
+        size_t size = block_size(pool, block);
+        if (size >= alloc_size && size - alloc_size >= aligned_gap(pool, block, alignment) &&
+                block_is_free(pool, block))
+            return block;
+
+        /**
+         * If the block canary is damaged, skip this block. The checksum
+         * is not computed for every block passed, only the canary is
+         * compared.
+         */
+        const MetaData *meta = block;
+        if (!is_compact(pool) && pool->integrity != POOL_DYN_INTEGRITY_NONE &&
+                meta->canary != CANARY_FREE && meta->canary != CANARY_USED)
+        {
+            LOG_BLOCK_DAMAGED(pool->mem_pool, block + sizeof(MetaData));
+            pool_last_error = POOL_BLOCK_DAMAGED;
+
+            block = find_next_block(pool, block);
+            continue;
+        }
+
+        block = block_next(pool, block);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Takes a free block of suitable size out of the index.
+ *
+ * A block whose metadata was damaged while it was in the index is dropped
+ * from it, the search continues with the next suitable block. Its header
+ * may be repaired later, so the block is marked as dropped to be neither
+ * removed from the index again nor taken for a listed block.
+ */
+static void *tlsf_take(PoolDyn *pool, size_t alloc_size)
+{
+    void *block;
+    while ((block = tlsf_find(pool, alloc_size)))
+    {
+        tlsf_remove(pool, block);
+        if (block_is_free(pool, block))
+            return block;
+
+        DynFreeLinks *links = free_links(pool, block);
+        links->prev = links->next = block;
+
+        LOG_BLOCK_DAMAGED(pool->mem_pool, block + pool->header_size);
+        pool_last_error = POOL_BLOCK_DAMAGED;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Returns the payload size of a block serving the request.
+ *
+ * The size is increased to the minimum, and the block is padded so that
+ * the payload of the next block (behind its header) stays aligned.
+ * Larger requests than the capacity are returned as they are, they fail
+ * anyway.
+ */
+static size_t block_alloc_size(const PoolDyn *pool, size_t size)
+{
+    size_t alloc_size = (size < pool->min_block) ? pool->min_block : size;
+
+    if (alloc_size <= pool->capacity)
+        alloc_size = MULTIPLICITY_UP(alloc_size + pool->header_size, pool->alignment) -
+            pool->header_size;
+    return alloc_size;
+}
+
+/**
+ * @brief Moves the mark of the never written memory behind the given address.
+ */
+static inline void mark_written(PoolDyn *pool, void *end)
+{
+    if (end > pool->zeroed)
+        pool->zeroed = end;
+}
+
+/**
+ * @brief Cuts the block down to the given size if the rest can hold
+ * a block of the minimum size.
+ *
+ * The rest becomes a busy block, the caller marks it free if needed.
+ * @return Header of the rest of the block, NULL if the block was not split.
+ */
+static void *split_block(PoolDyn *pool, void *block, size_t alloc_size)
+{
+    size_t size = block_size(pool, block);
+    if (size < (pool->header_size + alloc_size + pool->min_block))
+        return NULL;
+
+    void *new_block = block + pool->header_size + alloc_size;
+    if (!is_compact(pool))
+    {
+        MetaData *meta = block, *new_meta = new_block;
+        new_meta->canary = CANARY_USED;
+        new_meta->size = size - sizeof(MetaData) - alloc_size;
+        new_meta->next_block = meta->next_block;
+        new_meta->prev_block = meta;
+        new_meta->end_canary = END_CANARY;
+        seal(pool, new_meta);
+        if (new_meta->next_block)
+        {
+            new_meta->next_block->prev_block = new_meta;
+            seal(pool, new_meta->next_block);
+        }
+        meta->size = alloc_size;
+        meta->next_block = new_meta;
+        seal(pool, meta);
+    }
+    else
+    {
+        *(DynHeader *) new_block = size - sizeof(DynHeader) - alloc_size;
+        set_block_size(pool, block, alloc_size);
+    }
+
+    // The header and the links of the index (if any) were written
+    mark_written(pool, new_block + pool->header_size + DYN_TLSF_MIN_SIZE);
+    return new_block;
+}
+
+/**
+ * @brief Releases the pages inside a free block.
+ *
+ * The links of the free list at the start of the payload and the size a
+ * compact block keeps at its end stay in place.
+ * @return Number of bytes released.
+ */
+static size_t trim_block(const PoolDyn *pool, void *block)
+{
+    void *payload = block + pool->header_size;
+    return pool_pages_release(payload + DYN_TLSF_MIN_SIZE,
+            payload + block_size(pool, block) - sizeof(DynHeader), pool->pages);
+}
+
+/**
+ * @brief Marks a busy block free and merges it with its free neighbours.
+ */
+static void release_block(PoolDyn *pool, void *block)
+{
+    // A header left inside the merged block still rejects a second release
+    set_free(pool, block);
+    pool->size -= block_size(pool, block);
+
+    block = merge_neighbours(pool, block);
+    mark_free(pool, block);
+    free_insert(pool, block);
+
+    // The pages already released cost only a page table walk
+    if (pool->trim_threshold && block_size(pool, block) >= pool->trim_threshold)
+        trim_block(pool, block);
+}
+
+/**
+ * @brief Checks the pointer passed to pool_dyn_free or pool_dyn_realloc,
+ * restores damaged metadata.
+ * @return Header of the busy block, NULL if the pointer is invalid.
+ */
+static void *busy_block_meta(PoolDyn *pool, void *block)
+{
+    // We check that the transferred block address belong to the pool
+    if (block < pool->mem_pool || block > pool->mem_pool + pool->capacity)
+    {
+        LOG_POOL_ALIEN_PTR(block);
+        pool_last_error = POOL_INVALID_PTR;
+        return NULL;
+    }
+
+    // Check alignment
+    if ((uintptr_t) block % pool->alignment != 0)
+    {
+        LOG_POOL_PTR_NOT_ALIGNMENT(block);
+        pool_last_error = POOL_INVALID_PTR;
+        return NULL;
+    }
+
+    void *block_meta = block - pool->header_size;
+    if (!is_compact(pool))
+    {
+        // Checking the block's canary
+        if (header_damaged(pool, block_meta))
+        {
+            LOG_BLOCK_DAMAGED(pool->mem_pool, block);
+            restore_block(pool, block);
+
+            // If the block was not restored, return control
+            if (pool_last_error != POOL_OK)
+                return NULL;
+        }
+    }
+
+    // A free block may already be merged into its neighbour
+    if (is_compact(pool) ? (*(DynHeader *) block_meta & DYN_BLOCK_FREE) :
+            ((MetaData *) block_meta)->canary == CANARY_FREE)
+    {
+        LOG_POOL_INVALID_PTR(block);
+        pool_last_error = POOL_INVALID_PTR;
+        return NULL;
+    }
+
+    return block_meta;
+}
+
+/**
+ * @brief Allocates the beginning of a free block taken from the pool.
+ * @return Pointer to the payload.
+ */
+static void *use_block(PoolDyn *pool, void *block, size_t alloc_size)
+{
+    /**
+     * If after allocating the required amount of memory in the block
+     * there is enough space left for a new block of the minimum size,
+     * we divide the original block into 2 blocks
+     */
+    void *new_block = split_block(pool, block, alloc_size);
+    if (new_block)
+    {
+        pool->size += pool->header_size + alloc_size;
+        mark_free(pool, new_block);
+        free_insert(pool, new_block);
+    }
+    else
+        pool->size += block_size(pool, block);
+
+    mark_used(pool, block);
+    void *payload = block + pool->header_size;
+    mark_written(pool, payload + block_size(pool, block));
+
+    LOG_BLOCK_ALLOCATION(pool->mem_pool, payload, block_size(pool, block));
+
+    // Return the pointer to the beginning of the useful space
+    return payload;
+}
+
+/**
+ * @brief Clears the part of a new block that was written before.
+ * @param zeroed The mark of the never written memory before the allocation.
+ */
+static void clear_written(PoolDyn *pool, void *block, size_t size, void *zeroed)
+{
+    // Only the part of the block written before has to be cleared
+    if (block < zeroed)
+        memset(block, 0, (block + size <= zeroed) ? size : (size_t) (zeroed - block));
+
+    /**
+     * The size a free compact block keeps at its end lies below the mark,
+     * except for the last block of the pool.
+     */
+    void *last_size = pool->mem_pool + pool->capacity - sizeof(DynHeader);
+    if (is_compact(pool) && block + size > last_size && last_size >= zeroed)
+        memset(last_size, 0, sizeof(DynHeader));
+}
+
+/**
+ * @brief Allocates a block from one arena.
+ * @param alignment Alignment of the payload, the alignment of the arena
+ * or less for the plain allocation.
+ * @param zero The payload is cleared.
+ */
+static void *arena_alloc(PoolDyn *arena, size_t size, size_t alignment, bool zero)
+{
+    size_t alloc_size = block_alloc_size(arena, size);
+    if (alloc_size > (arena->capacity - arena->size))
+    {
+        LOG_POOL_NOT_FREE_SPACE(arena->mem_pool, arena->capacity - arena->size, alloc_size);
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+
+    // No free block is that large, there is nothing to search for
+    if (alloc_size > arena->stats.largest_free)
+    {
+        LOG_POOL_FRAGMENTED(arena->mem_pool, alloc_size);
+        pool_last_error = POOL_ALLOC_FAILED;
         return NULL;
     }
 
-    /** 
-     * We compensate for the memory occupied by metadata
-     * by default, 30% more memory is allocated.
-     * Then round this value to the nearest multiple of the
-     * minimum block size.
+    /**
+     * The index only tells the block sizes, so for a larger alignment it
+     * is asked for a block holding an aligned payload wherever the block
+     * starts.
      */
-    size_t final_capacity = MULTIPLICITY_UP((size_t) (capacity * ADVANCE), sizeof(MetaData) + MIN_ALLOC_SIZE);
+    void *zeroed = arena->zeroed;
+    bool aligned = alignment > arena->alignment;
+    void *block;
+    if (arena->tlsf)
+        block = tlsf_take(arena, aligned ?
+                alloc_size + alignment + arena->header_size + arena->min_block : alloc_size);
+    else
+        block = first_fit(arena, alloc_size, aligned ? alignment : arena->alignment);
+    if (!block)
+    {
+        // The next requests of this size are rejected without a search
+        if (!arena->largest_exact)
+            largest_refresh(arena);
 
-    /** 
-     * Overflow check
-     * We don't allocate more memory (in bytes) than the
-     * maximum value of the size_t type.
-     */
-    if (final_capacity < capacity)
-        final_capacity = MULTIPLICITY_DOWN(capacity, sizeof(MetaData) + MIN_ALLOC_SIZE);
+        LOG_POOL_FRAGMENTED(arena->mem_pool, alloc_size);
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+    stats_sub(arena, block_size(arena, block));
 
-    void *raw = malloc(final_capacity);
-    if (!raw)
+    // The gap in front of the aligned payload stays a free block
+    size_t gap = aligned ? aligned_gap(arena, block, alignment) : 0;
+    if (gap)
     {
-        LOG_POOL_CREATE_ERROR(sizeof(PoolDyn));
-        pool_last_error = POOL_CREATE_FAILED;
-        free(new_pool);
-        return NULL;
+        void *aligned_block = split_block(arena, block, gap - arena->header_size);
+        arena->size += arena->header_size;
+        mark_free(arena, block);
+        free_insert(arena, block);
+        block = aligned_block;
     }
 
-    // Align the address of the beginning of the pool
-    void *mem_pool = (void *) (((uintptr_t) raw + (ALIGNMENT - 1)) &
-            ~(ALIGNMENT - 1));
+    void *payload = use_block(arena, block, alloc_size);
+    if (zero)
+        clear_written(arena, payload, size, zeroed);
+    return payload;
+}
 
-    MetaData *block_meta = mem_pool;
+/**
+ * @brief Adds an arena large enough for the request to a growable pool.
+ * @return The new arena, NULL if it was not created.
+ */
+static PoolDyn *arena_add(PoolDyn *pool, size_t size, size_t alignment)
+{
+    size_t capacity = pool->growth_step;
+    if (pool->growth == POOL_DYN_GROW_DOUBLE)
+    {
+        capacity = 0;
+        for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+            capacity += arena->capacity;
+    }
 
-    // Empty pool is one big block
-    block_meta->size = final_capacity - sizeof(MetaData);
+    // The header, the padding and the gap in front of an aligned payload
+    size_t overhead = 2 * pool->header_size + pool->min_block + pool->alignment;
+    if (alignment > pool->alignment)
+        overhead += alignment + pool->header_size + pool->min_block;
+    if (size > SIZE_MAX - overhead)
+    {
+        LOG_POOL_NOT_FREE_SPACE(pool->mem_pool, (size_t) 0, size);
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+    if (capacity < size + overhead)
+        capacity = size + overhead;
+
+    PoolDynOptions options = {
+        .flags = pool->flags,
+        .alignment = pool->alignment,
+        .integrity = pool->integrity,
+        .growth = pool->growth,
+        .trim_threshold = pool->trim_threshold,
+    };
+    PoolDyn *arena = arena_create(capacity, &options);
+    if (!arena)
+    {
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
 
-    // If the pool been offst to align, the pool size is reduced by the offset difference
-    new_pool->capacity = final_capacity - ((uintptr_t) raw - (uintptr_t) mem_pool);
+    // The newest arena is the largest, it is searched right after the first
+    arena->pool = pool;
+    arena->next_arena = pool->next_arena;
+    pool->next_arena = arena;
+    return arena;
+}
 
-    block_meta->next_block = NULL;
-    block_meta->canary = CANARY_FREE;
-    block_meta->end_canary = END_CANARY;
-    new_pool->raw = raw;
-    new_pool->mem_pool = mem_pool;
-    new_pool->size = sizeof(MetaData);
-    LOG_POOL_CREATE_INFO(final_capacity, MIN_ALLOC_SIZE, (void *) raw);
+/**
+ * @brief Unlinks an added arena from its pool and frees it.
+ */
+static void arena_destroy(PoolDyn *pool, PoolDyn *arena)
+{
+    PoolDyn *prev = pool;
+    while (prev->next_arena != arena)
+        prev = prev->next_arena;
+    prev->next_arena = arena->next_arena;
+    if (pool->empty == arena)
+        pool->empty = NULL;
+    if (pool->coalesce_arena == arena)
+        pool->coalesce_arena = NULL;
+    arena_free(arena);
+}
 
-    return new_pool;
+/**
+ * @brief Returns the arena of the pool holding the block.
+ *
+ * The pool registry tells the arena in constant time. Pointers outside
+ * all arenas give the first one, which rejects them.
+ */
+static PoolDyn *arena_of(PoolDyn *pool, void *block)
+{
+    if (!pool->next_arena)
+        return pool;
+
+    PoolKind kind;
+    PoolDyn *arena = pool_registry_find(block, &kind);
+    return (kind == POOL_KIND_DYN && arena->pool == pool) ? arena : pool;
 }
 
 /**
- * @brief Finds and returns the next block in the pool
- * @param pool Pointer to the pool
- * @param block Initial block
- * @return Pointer to the next block
+ * @brief Accounts for a block returned to an arena.
+ *
+ * An added arena that becomes completely free is released. One empty
+ * arena is kept, otherwise alternating allocation and release on the
+ * growth boundary would create and destroy an arena every time.
  */
-void *find_next_block(PoolDyn *pool, void *block)
+static void arena_returned(PoolDyn *pool, PoolDyn *arena)
 {
-    MetaData *reference_block = pool->mem_pool;
-    size_t canary_size = sizeof(reference_block->canary);   // Pool advancement step
+    if (arena == pool || arena->size != arena->header_size || arena == pool->empty)
+        return;
 
-    /**
-     * If we get to this point there is no point in continuing. Either all the
-     * subsequent blocks we are looking for are corrupted, or the initial block is
-     * the last block in the pool.
-     */
-    void *stop_byte = pool->mem_pool + pool->capacity - MIN_ALLOC_SIZE;
-    MetaData *desired_block = block + canary_size;
+    if (!pool->empty || pool->empty->size != pool->empty->header_size)
+        pool->empty = arena;
+    else
+        arena_destroy(pool, arena);
+}
 
-    while ((uintptr_t) desired_block > (uintptr_t) stop_byte)
+/**
+ * @brief Allocates a block from the first arena of the pool that has one,
+ * adds an arena if there is none and the pool is growable.
+ */
+static void *dyn_alloc(PoolDyn *pool, size_t size, size_t alignment, bool zero)
+{
+    // A pool that cannot grow reports why its only arena failed
+    if (pool->growth == POOL_DYN_GROW_NONE)
+        return arena_alloc(pool, size, alignment, zero);
+
+    size_t alloc_size = block_alloc_size(pool, size);
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
     {
-        if ((desired_block->canary == CANARY_FREE || desired_block->canary == CANARY_USED) &&
-                desired_block->end_canary == END_CANARY)
+        // The arenas without a large enough free block are skipped without a search
+        if (alloc_size > arena->capacity - arena->size || alloc_size > arena->stats.largest_free)
+            continue;
+
+        void *block = arena_alloc(arena, size, alignment, zero);
+        if (block)
         {
-            return desired_block;
+            if (pool_last_error == POOL_ALLOC_FAILED)
+                pool_last_error = POOL_OK;
+            return block;
         }
-        desired_block = (void *) desired_block + canary_size;
     }
 
-    return NULL;
+    PoolDyn *arena = arena_add(pool, size, alignment);
+    if (!arena)
+        return NULL;
+
+    pool_last_error = POOL_OK;
+    return arena_alloc(arena, size, alignment, zero);
 }
 
 void *pool_dyn_alloc(PoolDyn *pool, size_t size)
@@ -112,145 +1316,131 @@ void *pool_dyn_alloc(PoolDyn *pool, size_t size)
         return NULL;
     }
 
-    /**
-     * Increase the allocated memory volume to the minimum
-     * or round up to a multiple.
-     */
-    size_t alloc_size;
-    if (size < MIN_ALLOC_SIZE)
-        alloc_size = MIN_ALLOC_SIZE;
-    else
-        alloc_size = MULTIPLICITY_UP(size, ALIGNMENT);
+    return dyn_alloc(pool, size, pool->alignment, false);
+}
 
-    if (alloc_size > (pool->capacity - pool->size))
+void *pool_dyn_alloc_aligned(PoolDyn *pool, size_t size, size_t alignment)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
     {
-        LOG_POOL_NOT_FREE_SPACE(pool->mem_pool, pool->capacity - pool->size, alloc_size);
-        pool_last_error = POOL_ALLOC_FAILED;
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
         return NULL;
     }
 
-    /**
-     * We are looking for a free block of suitable size
-     */
-    MetaData *block = pool->mem_pool;
-    bool find_flag = false;
-    while (block)
+    if (alignment > DYN_MAX_ALIGNMENT || (alignment & (alignment - 1)))
     {
-        if (block->canary == CANARY_FREE && block->size >= alloc_size)
-        {
-            find_flag = true;
-            break;
-        }
-
-        /**
-         * If the block canary is damaged, skip this block
-         */
-        if (block->canary != CANARY_FREE && block->canary != CANARY_USED)
-        {
-            LOG_BLOCK_DAMAGED(pool->mem_pool, (void *) block + sizeof(MetaData));
-            pool_last_error = POOL_BLOCK_DAMAGED;
-
-            block = (MetaData *) find_next_block(pool, (void *)block);
-            continue;
-        }
-
-        block = block->next_block;
+        LOG_POOL_INVALID_ARGS;
+        pool_last_error = POOL_INVALID_ARGS;
+        return NULL;
     }
 
-    if (find_flag)
-    {
-        /**
-         * If after allocating the required amount of memory in the block
-         * there is enough space left for a new block of the minimum size,
-         * we divide the original block into 2 blocks
-         */
-        if (block->size >= (sizeof(MetaData) + alloc_size + MIN_ALLOC_SIZE))
-        {
-            MetaData *new_block = (void *) block + sizeof(MetaData) + alloc_size;
-            new_block->canary = CANARY_FREE;
-            new_block->size = block->size - sizeof(MetaData) - alloc_size;
-            new_block->next_block = block->next_block;
-            new_block->end_canary = END_CANARY;
-
-            block->size = alloc_size;
-            block->next_block = new_block;
-            pool->size += sizeof(MetaData) + alloc_size;
-        }
-        else
-            pool->size += block->size;
-
-        block->canary = CANARY_USED;
-
-        LOG_BLOCK_ALLOCATION(pool->mem_pool, (void *)block + sizeof(MetaData), block->size);
+    return dyn_alloc(pool, size, alignment, false);
+}
 
-        // Move the pointer to the beginnin of the useful space and return if
-        return (void *)block + sizeof(MetaData);
+void *pool_dyn_calloc(PoolDyn *pool, size_t size)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return NULL;
     }
 
-    LOG_POOL_FRAGMENTED(pool->mem_pool, alloc_size);
-    pool_last_error = POOL_ALLOC_FAILED;
-    return NULL;
+    return dyn_alloc(pool, size, pool->alignment, true);
 }
 
 void *pool_dyn_alloc_safe(PoolDyn *pool, size_t size)
 {
-    void *block = pool_dyn_alloc(pool, size);
-    
     /**
-     * If the allocation fails, we check if there is
-     * enough free space in the pool,
-     * try to merge the free blocks, and retry the allocation.
+     * Free blocks are merged with their neighbours when they are
+     * released, a merge pass over the whole pool would find nothing.
      */
-    if (!block && pool->capacity - pool->size >= size)
-    {
-        coalesce_free_blocks(pool);
-        block = pool_dyn_alloc(pool, size);
-    }
-
-    return block;
+    return pool_dyn_alloc(pool, size);
 }
 
-void pool_dyn_free(PoolDyn *pool, void *block)
+void *pool_dyn_realloc(PoolDyn *pool, void *block, size_t size)
 {
     pool_last_error = POOL_OK;
-    if (!pool || !block)
+    if (!pool)
     {
         LOG_POOL_NULL_PTR;
         pool_last_error = POOL_NULL_PTR;
-        return;
+        return NULL;
     }
 
-    // We check that the transferred block address belong to the pool
-    if (block < pool->mem_pool || block > pool->mem_pool + pool->capacity)
+    if (!block)
+        return pool_dyn_alloc(pool, size);
+
+    // The block stays in its arena unless it moves
+    PoolDyn *owner = pool;
+    pool = arena_of(owner, block);
+    void *block_meta = busy_block_meta(pool, block);
+    if (!block_meta)
+        return NULL;
+
+    if (size == 0)
     {
-        LOG_POOL_ALIEN_PTR(block);
-        pool_last_error = POOL_INVALID_PTR;
-        return;
+        release_block(pool, block_meta);
+        arena_returned(owner, pool);
+        return NULL;
     }
 
-    // Check alignment
-    if ((uintptr_t) block % ALIGNMENT != 0)
+    size_t alloc_size = block_alloc_size(pool, size);
+
+    // The block grows in place by taking the free block behind it
+    void *next = block_next(pool, block_meta);
+    if (alloc_size > block_size(pool, block_meta) && next && block_is_free(pool, next) &&
+            block_size(pool, block_meta) + pool->header_size + block_size(pool, next) >= alloc_size)
     {
-        LOG_POOL_PTR_NOT_ALIGNMENT(block);
-        pool_last_error = POOL_INVALID_PTR;
-        return;
+        free_remove(pool, next);
+        pool->size += pool->header_size + block_size(pool, next);
+        absorb_next(pool, block_meta, next);
+        mark_used(pool, block_meta);
     }
 
-    MetaData *block_meta = block - sizeof(MetaData);
-    // Checking the block's canary
-    if (block_meta->canary != CANARY_FREE && block_meta->canary != CANARY_USED)
+    // The surplus is returned to the pool as a free block
+    if (alloc_size <= block_size(pool, block_meta))
     {
-        LOG_BLOCK_DAMAGED(pool->mem_pool, block);
-        restore_block(pool, block);
+        void *tail = split_block(pool, block_meta, alloc_size);
+        if (tail)
+            release_block(pool, tail);
+        mark_written(pool, block + block_size(pool, block_meta));
 
-        // If the block was not restored, return control
-        if (pool_last_error != POOL_OK)
-            return;
+        LOG_BLOCK_ALLOCATION(pool->mem_pool, block, block_size(pool, block_meta));
+        return block;
     }
 
-    block_meta->canary = CANARY_FREE;
-    pool->size -= block_meta->size;
+    // Otherwise the contents move to a new block
+    void *new_block = pool_dyn_alloc(owner, size);
+    if (!new_block)
+        return NULL;
+
+    memcpy(new_block, block, block_size(pool, block_meta));
+    release_block(pool, block_meta);
+    arena_returned(owner, pool);
+    return new_block;
+}
+
+void pool_dyn_free(PoolDyn *pool, void *block)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !block)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
 
+    PoolDyn *arena = arena_of(pool, block);
+    void *block_meta = busy_block_meta(arena, block);
+    if (block_meta)
+    {
+        release_block(arena, block_meta);
+        arena_returned(pool, arena);
+    }
 }
 
 void pool_dyn_clear(PoolDyn *pool)
@@ -263,10 +1453,11 @@ void pool_dyn_clear(PoolDyn *pool)
         return;
     }
 
-    MetaData *block_meta = pool->mem_pool;
-    pool->size = sizeof(MetaData);
-    block_meta->size = pool->capacity - sizeof(MetaData);
-    block_meta->canary = CANARY_FREE;
+    // A growable pool keeps only its first arena
+    while (pool->next_arena)
+        arena_destroy(pool, pool->next_arena);
+
+    reset_blocks(pool);
     LOG_POOL_CLEANUP(pool->mem_pool, pool->capacity);
 }
 
@@ -280,23 +1471,55 @@ void pool_dyn_destroy(PoolDyn *pool)
         return;
     }
 
-    free(pool->raw);
-    free(pool);
-    LOG_POOL_DESTROYED(pool->mem_pool);
+    while (pool->next_arena)
+        arena_destroy(pool, pool->next_arena);
+    arena_free(pool);
 }
 
-size_t pool_dyn_size(PoolDyn *pool)
+size_t pool_dyn_trim(PoolDyn *pool)
 {
     pool_last_error = POOL_OK;
     if (!pool)
     {
+        LOG_POOL_NULL_PTR;
         pool_last_error = POOL_NULL_PTR;
         return 0;
     }
-    return pool->size;
+
+    size_t released = 0;
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+        for (void *block = arena->mem_pool; block; block = block_next(arena, block))
+            if (block_is_free(arena, block))
+                released += trim_block(arena, block);
+    return released;
 }
 
-size_t pool_dyn_capacity(PoolDyn *pool)
+void pool_dyn_stats(PoolDyn *pool, PoolDynStats *stats)
+{
+    pool_last_error = POOL_OK;
+    if (!pool || !stats)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    memset(stats, 0, sizeof(PoolDynStats));
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+    {
+        if (!arena->largest_exact)
+            largest_refresh(arena);
+
+        stats->free_blocks += arena->stats.free_blocks;
+        stats->free_bytes += arena->stats.free_bytes;
+        if (arena->stats.largest_free > stats->largest_free)
+            stats->largest_free = arena->stats.largest_free;
+        for (size_t i = 0; i < DYN_STATS_BUCKETS; ++i)
+            stats->histogram[i] += arena->stats.histogram[i];
+    }
+}
+
+size_t pool_dyn_size(PoolDyn *pool)
 {
     pool_last_error = POOL_OK;
     if (!pool)
@@ -304,53 +1527,176 @@ size_t pool_dyn_capacity(PoolDyn *pool)
         pool_last_error = POOL_NULL_PTR;
         return 0;
     }
-    return pool->capacity;
+
+    size_t size = 0;
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+        size += arena->size;
+    return size;
 }
 
-void coalesce_free_blocks(PoolDyn *pool)
+size_t pool_dyn_capacity(PoolDyn *pool)
 {
-    LOG_POOL_OPTIMIZATION_ATTEMPT(pool->mem_pool);
     pool_last_error = POOL_OK;
     if (!pool)
     {
-        LOG_POOL_NULL_PTR;
-        LOG_POOL_OPTIMIZE_ERROR(pool->mem_pool);
         pool_last_error = POOL_NULL_PTR;
-        return;
+        return 0;
     }
 
-    MetaData *block_1 = pool->mem_pool;
-    MetaData *block_2 = block_1->next_block;
+    size_t capacity = 0;
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+        capacity += arena->capacity;
+    return capacity;
+}
+
+/**
+ * @brief Merges the block with the block behind it if both are free.
+ * @return 'true' if the blocks were merged.
+ */
+static bool merge_free_pair(PoolDyn *pool, void *block, void *next)
+{
+    if (!block_is_free(pool, block) || !block_is_free(pool, next))
+        return false;
+
+    free_remove(pool, block);
+    free_remove(pool, next);
+    absorb_next(pool, block, next);
+    mark_free(pool, block);
+    free_insert(pool, block);
+    return true;
+}
+
+/**
+ * @brief Merges the adjacent free blocks of one arena.
+ * @return 'true' if any blocks were merged.
+ */
+static bool arena_coalesce(PoolDyn *pool)
+{
+    void *block_1 = pool->mem_pool;
+    void *block_2 = block_next(pool, block_1);
     bool successful = false;
 
     while (block_2)
     {
         // If two adjacent blocks are free, we merge them.
-        if (block_1->canary == CANARY_FREE &&
-                block_2->canary == CANARY_FREE)
+        if (merge_free_pair(pool, block_1, block_2))
         {
-            block_1->next_block = block_2->next_block;
-            block_1->size += sizeof(MetaData) + block_2->size;
-            pool->size -= sizeof(MetaData);
             successful = true;
 
             /**
              * We move to the next block and try again (in case
              * free blocks follow each other)
              */
-            block_2 = block_2->next_block;
+            block_2 = block_next(pool, block_1);
             continue;
         }
         block_1 = block_2;
-        block_2 = block_2->next_block;
+        block_2 = block_next(pool, block_2);
+    }
+
+    // The blocks dropped from the index because of damaged metadata are counted again
+    free_rebuild(pool);
+    return successful;
+}
+
+void coalesce_free_blocks(PoolDyn *pool)
+{
+    LOG_POOL_OPTIMIZATION_ATTEMPT(pool->mem_pool);
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        LOG_POOL_OPTIMIZE_ERROR(pool->mem_pool);
+        pool_last_error = POOL_NULL_PTR;
+        return;
     }
 
+    bool successful = false;
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+        successful |= arena_coalesce(arena);
+
     if (successful)
         LOG_POOL_OPTIMIZE_SUCCESSFUL(pool->mem_pool);
     else
         LOG_POOL_OPTIMIZE_FAILED(pool->mem_pool);
 }
 
+// Number of blocks visited between the checks of the time budget
+#define COALESCE_CLOCK_STRIDE 32
+
+static uint64_t clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+bool pool_dyn_coalesce_step(PoolDyn *pool, const PoolDynBudget *budget)
+{
+    pool_last_error = POOL_OK;
+    if (!pool)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return true;
+    }
+
+    size_t max_blocks = budget ? budget->blocks : 0;
+    uint64_t max_ns = budget ? budget->ns : 0;
+    uint64_t start = max_ns ? clock_ns() : 0;
+
+    PoolDyn *arena = pool->coalesce_arena ? pool->coalesce_arena : pool;
+    void *block = arena->coalesce_cursor ? arena->coalesce_cursor : arena->mem_pool;
+    for (size_t visited = 1; ; ++visited)
+    {
+        // A dropped block whose header was repaired is indexed again
+        if (arena->tlsf && block_is_free(arena, block) && tlsf_dropped(arena, block))
+            tlsf_insert(arena, block);
+
+        // A merged block stays under the cursor, it may merge with the next one too
+        void *next = block_next(arena, block);
+        if (!next)
+        {
+            arena->coalesce_cursor = NULL;
+            arena = arena->next_arena;
+            if (!arena)
+            {
+                pool->coalesce_arena = NULL;
+                return true;
+            }
+            block = arena->mem_pool;
+        }
+        else if (!merge_free_pair(arena, block, next))
+            block = next;
+
+        if ((max_blocks && visited >= max_blocks) ||
+                (max_ns && visited % COALESCE_CLOCK_STRIDE == 0 && clock_ns() - start >= max_ns))
+        {
+            pool->coalesce_arena = arena;
+            arena->coalesce_cursor = block;
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Returns the intact header whose end canary (or checksum) is at the
+ * given address, NULL if there is none.
+ *
+ * The end canary is compared before the first one to exclude the
+ * possibility of a simple coincidence, a checksum is only computed for
+ * the addresses holding a valid first canary.
+ */
+static MetaData *header_ending_at(const PoolDyn *pool, uint64_t *end_canary)
+{
+    MetaData *meta = (void *) (end_canary + 1) - sizeof(MetaData);
+    if ((void *) meta < pool->mem_pool)
+        return NULL;
+    if (pool->integrity != POOL_DYN_INTEGRITY_CHECKSUM && meta->end_canary != END_CANARY)
+        return NULL;
+    return header_intact(pool, meta) ? meta : NULL;
+}
+
 void restore_block(PoolDyn *pool, void *block)
 {
     LOG_RESTORE_BLOCK(block);
@@ -364,6 +1710,13 @@ void restore_block(PoolDyn *pool, void *block)
         return;
     }
 
+    // The block may lie in an added arena of a growable pool
+    pool = arena_of(pool, block);
+
+    // Compact headers carry nothing to restore a block from
+    if (is_compact(pool) || pool->integrity == POOL_DYN_INTEGRITY_NONE)
+        return;
+
     // Check if the transferred address is in the range of the pool addresses
     if (block < pool->mem_pool || block > (pool->mem_pool + pool->capacity))
     {
@@ -374,7 +1727,7 @@ void restore_block(PoolDyn *pool, void *block)
     }
 
     // If the alignment is incorrect, then the block address is incorrect (there is an offset)
-    if ((uintptr_t) block % ALIGNMENT != 0)
+    if ((uintptr_t) block % pool->alignment != 0)
     {
         LOG_POOL_PTR_NOT_ALIGNMENT(block);
         LOG_BLOCK_RECOVERY_FAILED(pool->mem_pool, block);
@@ -396,7 +1749,7 @@ void restore_block(PoolDyn *pool, void *block)
 
 
     // Checking the canaries
-    if (block_meta->canary == CANARY_FREE || block_meta->canary == CANARY_USED)
+    if (!header_damaged(pool, block_meta))
         // If the first canary is not damaged, then the block is not damaged
         return;
 
@@ -407,18 +1760,9 @@ void restore_block(PoolDyn *pool, void *block)
 
     while(pool->mem_pool != (void *) end_canary)
     {
-        if (*end_canary == END_CANARY)
-        {
-            /**
-             * If a secind canary is found, we also check the first one to exclude
-             * the possibility of a simple coincidence
-             */
-            previous_block = ((void *) (end_canary + 1)) - sizeof(MetaData);  // !!!
-            if (previous_block->canary == CANARY_FREE || previous_block->canary == CANARY_USED)
-                break;
-            else
-                previous_block = NULL;
-        }
+        previous_block = header_ending_at(pool, end_canary);
+        if (previous_block)
+            break;
 
         --end_canary;
     }
@@ -434,16 +1778,10 @@ void restore_block(PoolDyn *pool, void *block)
      */
     while (pool_last_8_byte != (void *) end_canary)
     {
-        if (*end_canary == END_CANARY)
-        {
-            next_block = ((void *) (end_canary + 1)) - sizeof(MetaData);
-            /**
-             * If a secind canary is found, we also check the first one to exclude
-             * the possibility of a simple coincidence
-             */
-            if (next_block->canary == CANARY_FREE || next_block->canary == CANARY_USED)
-                break;
-        }
+        next_block = header_ending_at(pool, end_canary);
+        if (next_block)
+            break;
+
         ++end_canary;
     }
 
@@ -470,6 +1808,7 @@ void restore_block(PoolDyn *pool, void *block)
 
     block_meta->canary = CANARY_USED;
     block_meta->next_block = next_block;
+    block_meta->prev_block = previous_block;
     block_meta->end_canary = END_CANARY;
 
     if (next_block)
@@ -477,6 +1816,7 @@ void restore_block(PoolDyn *pool, void *block)
     else
         block_meta->size = pool->capacity -
             ((uintptr_t) block_meta - (uintptr_t) pool->mem_pool) - sizeof(MetaData);
+    seal(pool, block_meta);
 
     LOG_BLOCK_SUCCESSFUL_RECOVERY(block);
 }
@@ -0,0 +1,194 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pool_errors.h>
+#include <pool_logger.h>
+#include <log_macros.h>
+#include <pool_registry.h>
+#include <pool_alloc.h>
+
+extern _Thread_local char logger_buffer[256];
+
+/**
+ * Index of the highest set bit of a non-zero value.
+ */
+#define HIGH_BIT(value) (63 - __builtin_clzll((unsigned long long) (value)))
+
+size_t pool_size_class(size_t size)
+{
+    if (size <= 8)
+        return 0;
+    if (size <= 16)
+        return 1;
+
+    /**
+     * 2^p < size <= 2^(p + 1). Every power of two has two classes:
+     * 1.5 * 2^p and 2^(p + 1), the first one belongs to 16.
+     */
+    size_t p = HIGH_BIT(size - 1);
+    return 2 * (p - 4) + ((size <= ((size_t) 3 << (p - 1))) ? 2 : 3);
+}
+
+size_t pool_size_class_size(size_t index)
+{
+    if (index < 2)
+        return (index + 1) * 8;
+
+    size_t p = (index - 2) / 2 + 4;
+    return (index % 2 == 0) ? ((size_t) 3 << (p - 1)) : ((size_t) 1 << (p + 1));
+}
+
+/**
+ * @brief Returns the pool of the size class, creates it on first use.
+ */
+static PoolBlock *class_get(PoolAlloc *pa, size_t index)
+{
+    if (pa->classes[index])
+        return pa->classes[index];
+
+    size_t block_size = pool_size_class_size(index);
+    size_t capacity = pa->slab_size / block_size;
+    PoolBlockOptions options = {
+        .flags = POOL_BLOCK_BITMAP,
+        .growth = POOL_GROW_DOUBLE,
+        .growth_step = 0,
+    };
+
+    pa->classes[index] = pool_block_create_ex(capacity ? capacity : 1, block_size,
+            &options);
+    return pa->classes[index];
+}
+
+PoolAlloc *pool_alloc_create(size_t slab_size, size_t large_capacity)
+{
+    pool_last_error = POOL_OK;
+    PoolAlloc *pa = calloc(1, sizeof(PoolAlloc));
+    if (!pa)
+    {
+        LOG_POOL_CREATE_ERROR(sizeof(PoolAlloc));
+        pool_last_error = POOL_ALLOC_FAILED;
+        return NULL;
+    }
+
+    pa->slab_size = slab_size ? slab_size : DEFAULT_CLASS_SLAB_SIZE;
+    if (large_capacity)
+    {
+        PoolDynOptions options = { .growth = POOL_DYN_GROW_DOUBLE };
+        pa->large = pool_dyn_create_ex(large_capacity, &options);
+        if (!pa->large)
+        {
+            free(pa);
+            return NULL;
+        }
+    }
+
+    return pa;
+}
+
+void *pool_malloc(PoolAlloc *pa, size_t size)
+{
+    pool_last_error = POOL_OK;
+    if (!pa)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return NULL;
+    }
+
+    if (size > SIZE_CLASS_MAX)
+    {
+        if (!pa->large)
+        {
+            LOG_POOL_NOT_FREE_SPACE(pa, (size_t) 0, size);
+            pool_last_error = POOL_ALLOC_FAILED;
+            return NULL;
+        }
+
+        return pool_dyn_alloc_safe(pa->large, size);
+    }
+
+    PoolBlock *pool = class_get(pa, pool_size_class(size));
+    if (!pool)
+        return NULL;
+
+    return pool_block_alloc(pool);
+}
+
+void pool_free(PoolAlloc *pa, void *ptr)
+{
+    pool_last_error = POOL_OK;
+    if (!pa || !ptr)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    // The owner must be one of the size classes or an arena of the dynamic pool
+    PoolKind kind;
+    void *owner = pool_registry_find(ptr, &kind);
+    if (kind == POOL_KIND_DYN && ((PoolDyn *) owner)->pool == pa->large)
+    {
+        pool_dyn_free(pa->large, ptr);
+        return;
+    }
+
+    PoolBlock *pool = (kind == POOL_KIND_BLOCK) ? ((BlockSlab *) owner)->pool : NULL;
+    if (!pool || pool->block_size > SIZE_CLASS_MAX ||
+            pa->classes[pool_size_class(pool->block_size)] != pool)
+    {
+        LOG_POOL_ALIEN_PTR(ptr);
+        pool_last_error = POOL_INVALID_PTR;
+        return;
+    }
+
+    pool_block_free(pool, ptr);
+}
+
+void pool_free_any(void *ptr)
+{
+    pool_last_error = POOL_OK;
+    if (!ptr)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    PoolKind kind;
+    void *owner = pool_registry_find(ptr, &kind);
+    switch (kind)
+    {
+        case POOL_KIND_BLOCK:
+            pool_block_free(((BlockSlab *) owner)->pool, ptr);
+            break;
+        case POOL_KIND_DYN:
+            pool_dyn_free(((PoolDyn *) owner)->pool, ptr);
+            break;
+        default:
+            LOG_POOL_ALIEN_PTR(ptr);
+            pool_last_error = POOL_INVALID_PTR;
+            break;
+    }
+}
+
+void pool_alloc_destroy(PoolAlloc *pa)
+{
+    pool_last_error = POOL_OK;
+    if (!pa)
+    {
+        LOG_POOL_NULL_PTR;
+        pool_last_error = POOL_NULL_PTR;
+        return;
+    }
+
+    for (size_t i = 0; i < SIZE_CLASS_COUNT; ++i)
+        if (pa->classes[i])
+            pool_block_destroy(pa->classes[i]);
+    if (pa->large)
+        pool_dyn_destroy(pa->large);
+
+    free(pa);
+    pool_last_error = POOL_OK;
+}
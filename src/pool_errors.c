@@ -1,12 +1,13 @@
 #include <pool_errors.h>
 
-PoolError pool_last_error = POOL_OK;
+_Thread_local PoolError pool_last_error = POOL_OK;
 
 char *str_errors[] = {
     "POOL_OK",
     "POOL_CREATE_FAILED",
     "POOL_NULL_PTR",
     "POOL_INVALID_PTR",
+    "POOL_INVALID_ARGS",
     "POOL_ALLOC_FAILED",
     "POOL_BLOCK_DAMAGED"
 };
@@ -0,0 +1,72 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pool_pages.h>
+
+void *pool_pages_alloc(size_t size)
+{
+    void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (pages == MAP_FAILED) ? NULL : pages;
+}
+
+void *pool_pages_alloc_huge(size_t size, PoolPagesKind *kind)
+{
+    if (kind)
+        *kind = POOL_PAGES_BASE;
+
+#ifdef MAP_HUGETLB
+    void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pages != MAP_FAILED)
+    {
+        if (kind)
+            *kind = POOL_PAGES_HUGETLB;
+        return pages;
+    }
+#endif
+
+    // The mapping is trimmed to a huge page boundary at both ends
+    if (size > SIZE_MAX - POOL_PAGES_HUGE_SIZE)
+        return NULL;
+    void *raw = pool_pages_alloc(size + POOL_PAGES_HUGE_SIZE);
+    if (!raw)
+        return NULL;
+
+    uintptr_t start = ((uintptr_t) raw + POOL_PAGES_HUGE_SIZE - 1) & ~(POOL_PAGES_HUGE_SIZE - 1);
+    if (start != (uintptr_t) raw)
+        munmap(raw, start - (uintptr_t) raw);
+    munmap((void *) (start + size), (uintptr_t) raw + POOL_PAGES_HUGE_SIZE - start);
+
+#ifdef MADV_HUGEPAGE
+    if (madvise((void *) start, size, MADV_HUGEPAGE) == 0 && kind)
+        *kind = POOL_PAGES_THP;
+#endif
+    return (void *) start;
+}
+
+size_t pool_pages_release(void *start, void *end, PoolPagesKind kind)
+{
+    size_t page = (kind == POOL_PAGES_HUGETLB) ? POOL_PAGES_HUGE_SIZE :
+        (size_t) sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t) start + page - 1) & ~(page - 1);
+    uintptr_t last = (uintptr_t) end & ~(page - 1);
+    if (last <= first)
+        return 0;
+
+    // The lazy release is not available for reserved huge pages
+    int advice = MADV_DONTNEED;
+#ifdef MADV_FREE
+    if (POOL_PAGES_LAZY_FREE && kind != POOL_PAGES_HUGETLB)
+        advice = MADV_FREE;
+#endif
+    if (madvise((void *) first, last - first, advice) != 0)
+        return 0;
+    return last - first;
+}
+
+void pool_pages_free(void *pages, size_t size)
+{
+    if (pages)
+        munmap(pages, size);
+}
@@ -0,0 +1,177 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pool_registry.h>
+
+// Every level of the tree resolves the same number of page number bits.
+#define LEVEL_BITS ((REGISTRY_ADDRESS_BITS - REGISTRY_PAGE_SHIFT) / 3)
+#define LEVEL_SIZE ((size_t) 1 << LEVEL_BITS)
+#define LEVEL_MASK (LEVEL_SIZE - 1)
+
+// The owner is aligned, the type is kept in its low bits.
+#define KIND_MASK ((uintptr_t) 3)
+
+// Pages covered by a leaf and by a middle node.
+#define LEAF_PAGES LEVEL_SIZE
+#define MIDDLE_PAGES (LEVEL_SIZE << LEVEL_BITS)
+
+/**
+ * Inner node of the tree. A range covering the whole span of a slot
+ * stores its owner in the slot, so no child is needed below it.
+ */
+typedef struct registry_node {
+    _Atomic uintptr_t owners[LEVEL_SIZE];
+    _Atomic(void *) children[LEVEL_SIZE];
+} RegistryNode;
+
+/* Leaf of the tree, one entry per page */
+typedef struct registry_leaf {
+    _Atomic uintptr_t entries[LEVEL_SIZE];
+} RegistryLeaf;
+
+static RegistryNode registry_root;
+
+/**
+ * @brief Returns the child in the given slot, creates it if requested.
+ *
+ * Two threads may create the same child at once, the one losing the
+ * exchange frees its copy and uses the winner's.
+ */
+static void *child_get(_Atomic(void *) *slot, size_t size, bool create)
+{
+    void *child = atomic_load_explicit(slot, memory_order_acquire);
+    if (child || !create)
+        return child;
+
+    void *new_child = calloc(1, size);
+    if (!new_child)
+        return NULL;
+
+    if (!atomic_compare_exchange_strong_explicit(slot, &child, new_child,
+                memory_order_acq_rel, memory_order_acquire))
+    {
+        free(new_child);
+        return child;
+    }
+
+    return new_child;
+}
+
+/**
+ * @brief Tells whether the pages from the given one on cover the whole
+ * aligned span of the given number of pages before the last page.
+ */
+static inline bool span_covered(uintptr_t page, uintptr_t last, uintptr_t span)
+{
+    return !(page & (span - 1)) && last - page >= span - 1;
+}
+
+/**
+ * @brief Stores the value for all the pages of the range.
+ *
+ * The whole spans of the root and middle slots take one entry each, so
+ * the cost depends on the number of spans rather than pages. A range is
+ * always split the same way, its removal clears the entries it set.
+ */
+static bool range_set(const void *start, size_t size, uintptr_t value, bool create)
+{
+    uintptr_t first = (uintptr_t) start >> REGISTRY_PAGE_SHIFT;
+    uintptr_t last = ((uintptr_t) start + size - 1) >> REGISTRY_PAGE_SHIFT;
+    if (last >> (REGISTRY_ADDRESS_BITS - REGISTRY_PAGE_SHIFT))
+        return false;
+
+    uintptr_t page = first;
+    while (page <= last)
+    {
+        size_t root_slot = (page >> (2 * LEVEL_BITS)) & LEVEL_MASK;
+        if (span_covered(page, last, MIDDLE_PAGES))
+        {
+            atomic_store_explicit(&registry_root.owners[root_slot], value, memory_order_release);
+            page += MIDDLE_PAGES;
+            continue;
+        }
+
+        // Nothing to clear on removal in a missing subtree
+        RegistryNode *middle = child_get(&registry_root.children[root_slot],
+                sizeof(RegistryNode), create);
+        if (!middle && create)
+            break;
+        if (!middle)
+        {
+            page = (page | (MIDDLE_PAGES - 1)) + 1;
+            continue;
+        }
+
+        size_t middle_slot = (page >> LEVEL_BITS) & LEVEL_MASK;
+        if (span_covered(page, last, LEAF_PAGES))
+        {
+            atomic_store_explicit(&middle->owners[middle_slot], value, memory_order_release);
+            page += LEAF_PAGES;
+            continue;
+        }
+
+        RegistryLeaf *leaf = child_get(&middle->children[middle_slot],
+                sizeof(RegistryLeaf), create);
+        if (!leaf && create)
+            break;
+        if (!leaf)
+        {
+            page = (page | (LEAF_PAGES - 1)) + 1;
+            continue;
+        }
+
+        atomic_store_explicit(&leaf->entries[page & LEVEL_MASK], value, memory_order_release);
+        ++page;
+    }
+
+    if (page <= last)
+    {
+        // The tree could not be extended, undo the registration
+        if (page > first)
+            range_set(start, (page - first) << REGISTRY_PAGE_SHIFT, 0, false);
+        return false;
+    }
+
+    return true;
+}
+
+bool pool_registry_add(const void *start, size_t size, void *owner, PoolKind kind)
+{
+    if (!start || !size || ((uintptr_t) start & (REGISTRY_PAGE_SIZE - 1)))
+        return false;
+
+    return range_set(start, size, (uintptr_t) owner | (uintptr_t) kind, true);
+}
+
+void pool_registry_remove(const void *start, size_t size)
+{
+    if (start && size)
+        range_set(start, size, 0, false);
+}
+
+void *pool_registry_find(const void *ptr, PoolKind *kind)
+{
+    uintptr_t page = (uintptr_t) ptr >> REGISTRY_PAGE_SHIFT;
+    uintptr_t value = 0;
+    if (!(page >> (REGISTRY_ADDRESS_BITS - REGISTRY_PAGE_SHIFT)))
+    {
+        size_t root_slot = (page >> (2 * LEVEL_BITS)) & LEVEL_MASK;
+        size_t middle_slot = (page >> LEVEL_BITS) & LEVEL_MASK;
+        value = atomic_load_explicit(&registry_root.owners[root_slot], memory_order_acquire);
+        RegistryNode *middle = value ? NULL : child_get(&registry_root.children[root_slot],
+                sizeof(RegistryNode), false);
+        if (middle)
+            value = atomic_load_explicit(&middle->owners[middle_slot], memory_order_acquire);
+        RegistryLeaf *leaf = (value || !middle) ? NULL :
+            child_get(&middle->children[middle_slot], sizeof(RegistryLeaf), false);
+        if (leaf)
+            value = atomic_load_explicit(&leaf->entries[page & LEVEL_MASK], memory_order_acquire);
+    }
+
+    if (kind)
+        *kind = (PoolKind) (value & KIND_MASK);
+
+    return (void *) (value & ~KIND_MASK);
+}
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <pool_errors.h>
+#include <block_pool_atomic.h>
+
+#define ATOMIC_THREADS 8
+#define ATOMIC_ROUNDS 50000
+#define ATOMIC_HELD 16
+#define ATOMIC_CAPACITY 100
+
+void test_block_pool_atomic_basic(void)
+{
+    PoolBlockAtomic *pool = pool_block_atomic_create(3, 24);
+    assert(pool != NULL);
+    assert(pool_block_atomic_capacity(pool) == 3);
+
+    void *block_1 = pool_block_atomic_alloc(pool);
+    void *block_2 = pool_block_atomic_alloc(pool);
+    void *block_3 = pool_block_atomic_alloc(pool);
+    assert(block_1 && block_2 && block_3);
+    assert((uintptr_t) block_1 % BLOCK_POOL_ALIGNMENT == 0);
+    assert(pool_block_atomic_size(pool) == 3);
+
+    void *extra = pool_block_atomic_alloc(pool);
+    assert(extra == NULL);
+    assert(pool_last_error == POOL_ALLOC_FAILED);
+
+    // Freed blocks come back in LIFO order
+    pool_block_atomic_free(pool, block_2);
+    pool_block_atomic_free(pool, block_1);
+    assert(pool_last_error == POOL_OK);
+    void *reused = pool_block_atomic_alloc(pool);
+    assert(reused == block_1);
+
+    // Double free and foreign pointers are rejected
+    pool_block_atomic_free(pool, block_2);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_block_atomic_free(pool, (char *) block_3 + 8);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    int dummy;
+    pool_block_atomic_free(pool, &dummy);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_block_atomic_free(pool, NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+    assert(pool_block_atomic_size(pool) == 2);
+
+    pool_block_atomic_clear(pool);
+    assert(pool_block_atomic_size(pool) == 0);
+
+    // A block busy before the cleanup is not freed again
+    pool_block_atomic_free(pool, block_3);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    assert(pool_block_atomic_size(pool) == 0);
+    for (int i = 0; i < 3; ++i)
+    {
+        void *block = pool_block_atomic_alloc(pool);
+        assert(block != NULL);
+    }
+
+    pool_block_atomic_destroy(pool);
+    printf("test_block_pool_atomic_basic: OK\n");
+}
+
+/**
+ * Every thread keeps a few blocks marked with its id and keeps replacing
+ * them. A block handed out twice would have its mark overwritten.
+ */
+static void *atomic_worker(void *arg)
+{
+    PoolBlockAtomic *pool = ((void **) arg)[0];
+    uintptr_t id = (uintptr_t) ((void **) arg)[1];
+    uintptr_t *held[ATOMIC_HELD] = {0};
+    uint64_t rng = id * 0x9E3779B97F4A7C15;
+
+    for (int round = 0; round < ATOMIC_ROUNDS; ++round)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t i = rng % ATOMIC_HELD;
+
+        if (held[i])
+        {
+            assert(*held[i] == id);
+            pool_block_atomic_free(pool, held[i]);
+            assert(pool_last_error == POOL_OK);
+            held[i] = NULL;
+        }
+        else if ((held[i] = pool_block_atomic_alloc(pool)))
+            *held[i] = id;
+    }
+
+    for (size_t i = 0; i < ATOMIC_HELD; ++i)
+        if (held[i])
+            pool_block_atomic_free(pool, held[i]);
+
+    return NULL;
+}
+
+void test_block_pool_atomic_stress(void)
+{
+    // Fewer blocks than the threads want, so the pool runs dry regularly
+    PoolBlockAtomic *pool = pool_block_atomic_create(ATOMIC_CAPACITY, 8);
+    assert(pool != NULL);
+
+    pthread_t threads[ATOMIC_THREADS];
+    void *args[ATOMIC_THREADS][2];
+    for (uintptr_t i = 0; i < ATOMIC_THREADS; ++i)
+    {
+        args[i][0] = pool;
+        args[i][1] = (void *) (i + 1);
+        int created = pthread_create(&threads[i], NULL, atomic_worker, args[i]);
+        assert(created == 0);
+    }
+
+    for (int i = 0; i < ATOMIC_THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    assert(pool_block_atomic_size(pool) == 0);
+
+    // The free stack is intact: every block can be allocated exactly once
+    void *blocks[ATOMIC_CAPACITY];
+    for (int i = 0; i < ATOMIC_CAPACITY; ++i)
+    {
+        blocks[i] = pool_block_atomic_alloc(pool);
+        assert(blocks[i] != NULL);
+        for (int j = 0; j < i; ++j)
+            assert(blocks[j] != blocks[i]);
+    }
+    void *extra = pool_block_atomic_alloc(pool);
+    assert(extra == NULL);
+
+    pool_block_atomic_destroy(pool);
+    printf("test_block_pool_atomic_stress: OK\n");
+}
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <pool_errors.h>
+#include <block_pool_mag.h>
+
+#define MAG_THREADS 4
+#define MAG_ROUNDS 20000
+#define MAG_BURST 48
+
+void test_block_pool_mag_basic(void)
+{
+    PoolBlockMag *pool = pool_block_mag_create(10, 16, 4);
+    assert(pool != NULL);
+    assert(pool_block_mag_capacity(pool) == 10);
+
+    // All the blocks can be allocated through the magazines
+    void *blocks[10];
+    for (int i = 0; i < 10; ++i)
+    {
+        blocks[i] = pool_block_mag_alloc(pool);
+        assert(blocks[i] != NULL && pool_last_error == POOL_OK);
+    }
+    assert(pool_block_mag_size(pool) == 10);
+
+    void *extra = pool_block_mag_alloc(pool);
+    assert(extra == NULL);
+    assert(pool_last_error == POOL_ALLOC_FAILED);
+
+    // Freed blocks are cached and reused
+    for (int i = 0; i < 10; ++i)
+    {
+        pool_block_mag_free(pool, blocks[i]);
+        assert(pool_last_error == POOL_OK);
+    }
+    assert(pool_block_mag_size(pool) == 0);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        blocks[i] = pool_block_mag_alloc(pool);
+        assert(blocks[i] != NULL);
+    }
+
+    // Invalid pointers are rejected
+    int dummy;
+    pool_block_mag_free(pool, &dummy);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_block_mag_free(pool, NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+
+    PoolBlockMag *invalid = pool_block_mag_create(0, 16, 4);
+    assert(invalid == NULL);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+
+    pool_block_mag_destroy(pool);
+    printf("test_block_pool_mag_basic: OK\n");
+}
+
+/**
+ * Every thread allocates bursts of blocks, marks them with its id, checks
+ * that no other thread got the same blocks and frees them again.
+ */
+static void *mag_worker(void *arg)
+{
+    PoolBlockMag *pool = ((void **) arg)[0];
+    uintptr_t id = (uintptr_t) ((void **) arg)[1];
+    uintptr_t *blocks[MAG_BURST];
+
+    for (int round = 0; round < MAG_ROUNDS; ++round)
+    {
+        for (int i = 0; i < MAG_BURST; ++i)
+        {
+            blocks[i] = pool_block_mag_alloc(pool);
+            assert(blocks[i] != NULL);
+            *blocks[i] = id;
+        }
+
+        for (int i = 0; i < MAG_BURST; ++i)
+        {
+            assert(*blocks[i] == id);
+            pool_block_mag_free(pool, blocks[i]);
+            assert(pool_last_error == POOL_OK);
+        }
+    }
+
+    return NULL;
+}
+
+void test_block_pool_mag_threads(void)
+{
+    // Room for the bursts plus the magazines cached by every thread
+    PoolBlockMag *pool = pool_block_mag_create(MAG_THREADS * (MAG_BURST + 3 * 16), 8, 16);
+    assert(pool != NULL);
+
+    pthread_t threads[MAG_THREADS];
+    void *args[MAG_THREADS][2];
+    for (uintptr_t i = 0; i < MAG_THREADS; ++i)
+    {
+        args[i][0] = pool;
+        args[i][1] = (void *) (i + 1);
+        int created = pthread_create(&threads[i], NULL, mag_worker, args[i]);
+        assert(created == 0);
+    }
+
+    for (int i = 0; i < MAG_THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    // The magazines of the finished threads went back to the depot
+    assert(pool_block_mag_size(pool) == 0);
+    assert(pool->caches == NULL);
+
+    pool_block_mag_destroy(pool);
+    printf("test_block_pool_mag_threads: OK\n");
+}
@@ -1,6 +1,9 @@
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <pool_errors.h>
 #include <block_pool.h>
 
@@ -120,3 +123,669 @@ void test_block_pool_alignment(void)
     pool_block_destroy(pool);
     printf("test_block_pool_alignment: OK\n");
 }
+
+void test_block_pool_free_list(void)
+{
+    PoolBlock *pool = pool_block_create(3, 16);
+    assert(pool != NULL);
+
+    void *block_1 = pool_block_alloc(pool);
+    void *block_2 = pool_block_alloc(pool);
+    void *block_3 = pool_block_alloc(pool);
+    assert(block_1 != NULL && block_2 != NULL && block_3 != NULL);
+
+    // The blocks must not overlap each other's headers
+    assert((uintptr_t) block_2 - (uintptr_t) block_1 >= 16 + BLOCK_POOL_ALIGNMENT);
+
+    // Freed blocks are reused in LIFO order
+    pool_block_free(pool, block_1);
+    pool_block_free(pool, block_3);
+    void *reused_3 = pool_block_alloc(pool);
+    void *reused_1 = pool_block_alloc(pool);
+    assert(reused_3 == block_3 && reused_1 == block_1);
+
+    void *extra = pool_block_alloc(pool);
+    assert(extra == NULL && pool_last_error == POOL_ALLOC_FAILED);
+
+    // Double free is detected
+    pool_block_free(pool, block_2);
+    assert(pool_last_error == POOL_OK);
+    pool_block_free(pool, block_2);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    assert(pool->size == 2);
+
+    // After the cleanup all the blocks are available again
+    pool_block_clear(pool);
+    assert(pool->size == 0);
+    for (int i = 0; i < 3; ++i)
+    {
+        void *block = pool_block_alloc(pool);
+        assert(block != NULL);
+    }
+    extra = pool_block_alloc(pool);
+    assert(extra == NULL);
+
+    pool_block_destroy(pool);
+    printf("test_block_pool_free_list: OK\n");
+}
+
+void test_block_pool_bitmap(void)
+{
+    const size_t capacity = 130;    // Not a multiple of the bitmap word
+    PoolBlockOptions options = { .flags = POOL_BLOCK_BITMAP };
+
+    PoolBlock *pool = pool_block_create_ex(capacity, 16, &options);
+    assert(pool != NULL);
+
+    // Blocks carry no header
+    assert(pool->block_size == 16);
+
+    void *blocks[130];
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        assert(blocks[i] != NULL);
+        assert((uintptr_t) blocks[i] % BLOCK_POOL_ALIGNMENT == 0);
+        if (i > 0)
+            assert((uintptr_t) blocks[i] - (uintptr_t) blocks[i - 1] == 16);
+    }
+
+    // The tail of the last bitmap word is never handed out
+    void *extra = pool_block_alloc(pool);
+    assert(extra == NULL && pool_last_error == POOL_ALLOC_FAILED);
+
+    // The lowest free block is reused first
+    pool_block_free(pool, blocks[100]);
+    pool_block_free(pool, blocks[3]);
+    void *lowest = pool_block_alloc(pool);
+    void *next = pool_block_alloc(pool);
+    assert(lowest == blocks[3] && next == blocks[100]);
+
+    // Double free and invalid pointers are detected
+    pool_block_free(pool, blocks[70]);
+    assert(pool_last_error == POOL_OK);
+    pool_block_free(pool, blocks[70]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_block_free(pool, (char *) blocks[71] + 1);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    assert(pool->size == capacity - 1);
+
+    pool_block_clear(pool);
+    assert(pool->size == 0);
+    void *first = pool_block_alloc(pool);
+    assert(first == blocks[0]);
+
+    pool_block_destroy(pool);
+    printf("test_block_pool_bitmap: OK\n");
+}
+
+void test_block_pool_growable(void)
+{
+    PoolBlockOptions options = { .growth = POOL_GROW_DOUBLE };
+    PoolBlock *pool = pool_block_create_ex(4, 16, &options);
+    assert(pool != NULL);
+
+    // The pool doubles its capacity: 4 -> 8 -> 16 -> 32
+    size_t *blocks[20];
+    for (size_t i = 0; i < 20; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        assert(blocks[i] != NULL);
+        *blocks[i] = i;
+    }
+    assert(pool->size == 20);
+    assert(pool->capacity == 32);
+
+    // Blocks did not move when the pool has grown
+    for (size_t i = 0; i < 20; ++i)
+        assert(*blocks[i] == i);
+
+    // Blocks of every slab are recognized
+    for (size_t i = 0; i < 20; ++i)
+        assert(pool_block_contains(pool, blocks[i]));
+    int dummy;
+    pool_block_free(pool, &dummy);
+    assert(pool_last_error == POOL_INVALID_PTR);
+
+    // Emptying the third slab (blocks 8-15) keeps it as a reserve
+    for (size_t i = 8; i < 16; ++i)
+    {
+        pool_block_free(pool, blocks[i]);
+        assert(pool_last_error == POOL_OK);
+    }
+    assert(pool->capacity == 32);
+
+    // Emptying the second slab (blocks 4-7) as well releases it
+    for (size_t i = 4; i < 8; ++i)
+        pool_block_free(pool, blocks[i]);
+    assert(pool->capacity == 28);
+    assert(pool->size == 8);
+
+    // Released block pointers are no longer valid
+    pool_block_free(pool, blocks[4]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+
+    // Cleanup keeps only the first slab
+    pool_block_clear(pool);
+    assert(pool->size == 0);
+    assert(pool->capacity == 4);
+    pool_block_destroy(pool);
+
+    // Growth by a fixed step
+    options.growth = POOL_GROW_FIXED;
+    options.growth_step = 3;
+    options.flags = POOL_BLOCK_BITMAP;
+    pool = pool_block_create_ex(2, 8, &options);
+    assert(pool != NULL);
+    for (size_t i = 0; i < 6; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        assert(blocks[i] != NULL);
+    }
+    assert(pool->capacity == 8);
+
+    options.growth_step = 0;
+    PoolBlock *invalid = pool_block_create_ex(2, 8, &options);
+    assert(invalid == NULL);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+
+    pool_block_destroy(pool);
+    printf("test_block_pool_growable: OK\n");
+}
+
+void test_block_pool_batch(void)
+{
+    void *blocks[40];
+
+    PoolBlock *pool = pool_block_create(32, 16);
+    assert(pool != NULL);
+
+    // A batch larger than the pool returns what is available
+    size_t count = pool_block_alloc_n(pool, blocks, 24);
+    assert(count == 24 && pool_last_error == POOL_OK);
+    count = pool_block_alloc_n(pool, blocks + 24, 16);
+    assert(count == 8 && pool_last_error == POOL_ALLOC_FAILED);
+    assert(pool->size == 32);
+
+    for (int i = 0; i < 32; ++i)
+        for (int j = 0; j < i; ++j)
+            assert(blocks[i] != blocks[j]);
+
+    // Invalid entries are skipped, the rest of the batch is freed
+    int dummy;
+    void *invalid[] = {blocks[0], &dummy, blocks[1], blocks[1], NULL, blocks[2]};
+    count = pool_block_free_n(pool, invalid, 6);
+    assert(count == 3 && pool_last_error != POOL_OK);
+    assert(pool->size == 29);
+
+    count = pool_block_free_n(pool, blocks + 3, 29);
+    assert(count == 29 && pool_last_error == POOL_OK);
+    assert(pool->size == 0);
+    pool_block_destroy(pool);
+
+    // Batches spanning several slabs of a growable pool
+    PoolBlockOptions options = { .flags = POOL_BLOCK_BITMAP, .growth = POOL_GROW_FIXED,
+        .growth_step = 8 };
+    pool = pool_block_create_ex(8, 8, &options);
+    assert(pool != NULL);
+
+    count = pool_block_alloc_n(pool, blocks, 40);
+    assert(count == 40);
+    assert(pool->capacity == 40);
+
+    // Freeing everything releases all the slabs except the reserve
+    count = pool_block_free_n(pool, blocks, 40);
+    assert(count == 40);
+    assert(pool->size == 0);
+    assert(pool->capacity == 8);
+
+    pool_block_destroy(pool);
+    printf("test_block_pool_batch: OK\n");
+}
+
+void test_block_pool_clear_epoch(void)
+{
+    const size_t capacity = 200;
+    PoolBlockOptions layouts[] = {{ .flags = 0 }, { .flags = POOL_BLOCK_BITMAP }};
+
+    for (int l = 0; l < 2; ++l)
+    {
+        PoolBlock *pool = pool_block_create_ex(capacity, 24, &layouts[l]);
+        assert(pool != NULL);
+
+        void *blocks[200];
+        for (int round = 0; round < 1000; ++round)
+        {
+            // Scattered live blocks: every third one is freed again
+            for (size_t i = 0; i < capacity; ++i)
+                blocks[i] = pool_block_alloc(pool);
+            for (size_t i = 0; i < capacity; i += 3)
+                pool_block_free(pool, blocks[i]);
+
+            pool_block_clear(pool);
+            assert(pool_block_size(pool) == 0);
+        }
+
+        // Blocks allocated before the cleanup cannot be freed after it
+        pool_block_free(pool, blocks[1]);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        void *block = pool_block_alloc(pool);
+        pool_block_free(pool, blocks[capacity - 1]);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        assert(pool_block_size(pool) == 1);
+
+        // The whole capacity is available again
+        for (size_t i = 1; i < capacity; ++i)
+        {
+            blocks[i] = pool_block_alloc(pool);
+            assert(blocks[i] != NULL);
+        }
+        void *extra = pool_block_alloc(pool);
+        assert(extra == NULL);
+
+        pool_block_free(pool, block);
+        assert(pool_last_error == POOL_OK);
+
+        pool_block_destroy(pool);
+    }
+
+    printf("test_block_pool_clear_epoch: OK\n");
+}
+
+void test_block_pool_aligned(void)
+{
+    const size_t alignments[] = {16, 32, 64, 4096};
+    PoolBlockOptions layouts[] = {{ .flags = 0 }, { .flags = POOL_BLOCK_BITMAP }};
+
+    for (int l = 0; l < 2; ++l)
+    for (size_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); ++a)
+    {
+        layouts[l].alignment = alignments[a];
+        PoolBlock *pool = pool_block_create_ex(5, 40, &layouts[l]);
+        assert(pool != NULL);
+        assert(pool->alignment == alignments[a]);
+
+        void *blocks[5];
+        for (int i = 0; i < 5; ++i)
+        {
+            blocks[i] = pool_block_alloc(pool);
+            assert(blocks[i] != NULL);
+            assert((uintptr_t) blocks[i] % alignments[a] == 0);
+        }
+
+        // Pointers inside an aligned block are rejected
+        pool_block_free(pool, (char *) blocks[2] + 8);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        for (int i = 0; i < 5; ++i)
+            pool_block_free(pool, blocks[i]);
+        assert(pool_last_error == POOL_OK && pool_block_size(pool) == 0);
+
+        pool_block_destroy(pool);
+    }
+
+    // Cache-line isolated blocks never share a line
+    PoolBlockOptions isolated = { .flags = POOL_BLOCK_BITMAP | POOL_BLOCK_CACHE_ALIGNED };
+    PoolBlock *pool = pool_block_create_ex(4, sizeof(uint64_t), &isolated);
+    assert(pool != NULL);
+    assert(pool->block_size == CACHE_LINE_SIZE);
+    void *first = pool_block_alloc(pool);
+    void *second = pool_block_alloc(pool);
+    assert((uintptr_t) first % CACHE_LINE_SIZE == 0);
+    assert((uintptr_t) second - (uintptr_t) first == CACHE_LINE_SIZE);
+    pool_block_destroy(pool);
+
+    pool = pool_block_create_aligned(4, 100, 64);
+    assert(pool != NULL);
+    first = pool_block_alloc(pool);
+    assert((uintptr_t) first % 64 == 0);
+    pool_block_destroy(pool);
+
+    // The alignment must be a power of 2 within the supported range
+    pool = pool_block_create_aligned(4, 16, 24);
+    assert(pool == NULL && pool_last_error == POOL_INVALID_ARGS);
+    pool = pool_block_create_aligned(4, 16, 8192);
+    assert(pool == NULL);
+    pool = pool_block_create_aligned(4, 16, 0);
+    assert(pool == NULL);
+
+    printf("test_block_pool_aligned: OK\n");
+}
+
+/* Records the visited blocks */
+typedef struct {
+    void *blocks[300];
+    size_t count;
+    PoolBlock *pool;    // Pool whose visited blocks are freed, if set
+} VisitLog;
+
+static void record_block(void *memblock, void *ctx)
+{
+    VisitLog *log = ctx;
+    log->blocks[log->count++] = memblock;
+    if (log->pool)
+        pool_block_free(log->pool, memblock);
+}
+
+static void count_block(void *memblock, void *ctx)
+{
+    (void) memblock;
+    __atomic_fetch_add((size_t *) ctx, 1, __ATOMIC_RELAXED);
+}
+
+void test_block_pool_foreach(void)
+{
+    const size_t capacity = 300;
+    PoolBlockOptions layouts[] = {{ .flags = 0 }, { .flags = POOL_BLOCK_BITMAP }};
+    static VisitLog log;
+
+    for (int l = 0; l < 2; ++l)
+    {
+        PoolBlock *pool = pool_block_create_ex(capacity, 16, &layouts[l]);
+        assert(pool != NULL);
+
+        // Every third block stays busy, the tail of the pool is untouched
+        void *blocks[300];
+        for (size_t i = 0; i < 250; ++i)
+            blocks[i] = pool_block_alloc(pool);
+        for (size_t i = 0; i < 250; ++i)
+            if (i % 3 != 0)
+                pool_block_free(pool, blocks[i]);
+
+        log.count = 0;
+        log.pool = NULL;
+        pool_block_foreach(pool, record_block, &log);
+        assert(pool_last_error == POOL_OK);
+        assert(log.count == 84);
+        for (size_t i = 0; i < log.count; ++i)
+            assert(log.blocks[i] == blocks[i * 3]);
+
+        // The cursor returns the same blocks
+        PoolBlockIter iter;
+        pool_block_iter_init(&iter, pool);
+        void *next;
+        for (size_t i = 0; i < log.count; ++i) {
+            next = pool_block_iter_next(&iter);
+            assert(next == log.blocks[i]);
+        }
+        next = pool_block_iter_next(&iter);
+        assert(next == NULL);
+
+        size_t counted = 0;
+        pool_block_foreach_parallel(pool, count_block, &counted, 4);
+        assert(pool_last_error == POOL_OK && counted == 84);
+
+        pool_block_clear(pool);
+        pool_block_iter_init(&iter, pool);
+        next = pool_block_iter_next(&iter);
+        assert(next == NULL);
+
+        pool_block_destroy(pool);
+    }
+
+    // The visitor frees every block of a growable pool with several slabs
+    PoolBlockOptions growable = { .flags = POOL_BLOCK_BITMAP, .growth = POOL_GROW_FIXED,
+        .growth_step = 10 };
+    PoolBlock *pool = pool_block_create_ex(10, 32, &growable);
+    assert(pool != NULL);
+    void *block;
+    for (size_t i = 0; i < 35; ++i) {
+        block = pool_block_alloc(pool);
+        assert(block != NULL);
+    }
+
+    log.count = 0;
+    log.pool = pool;
+    pool_block_foreach(pool, record_block, &log);
+    assert(log.count == 35 && pool_block_size(pool) == 0);
+
+    // Only one empty slab is kept
+    assert(pool_block_capacity(pool) == 10);
+    for (size_t i = 0; i < 35; ++i) {
+        block = pool_block_alloc(pool);
+        assert(block != NULL);
+    }
+
+    pool_block_foreach(NULL, record_block, &log);
+    assert(pool_last_error == POOL_NULL_PTR);
+    pool_block_foreach_parallel(pool, count_block, &log, 0);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+
+    pool_block_destroy(pool);
+    printf("test_block_pool_foreach: OK\n");
+}
+
+void test_block_pool_handles(void)
+{
+    const size_t capacity = 100;
+    PoolBlockOptions layouts[] = {{ .flags = POOL_BLOCK_HANDLES },
+        { .flags = POOL_BLOCK_BITMAP | POOL_BLOCK_HANDLES }};
+
+    for (int l = 0; l < 2; ++l)
+    {
+        PoolBlock *pool = pool_block_create_ex(capacity, 24, &layouts[l]);
+        assert(pool != NULL);
+
+        PoolHandle handles[100];
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            handles[i] = pool_block_alloc_handle(pool);
+            assert(handles[i] != POOL_NULL_HANDLE);
+            int *value = pool_block_deref(pool, handles[i]);
+            assert(value != NULL && pool_block_contains(pool, value));
+            *value = (int) i;
+        }
+        PoolHandle extra = pool_block_alloc_handle(pool);
+        assert(extra == POOL_NULL_HANDLE);
+        for (size_t i = 0; i < capacity; ++i)
+            assert(*(int *) pool_block_deref(pool, handles[i]) == (int) i);
+
+        // A freed block does not match its handle, even when it is reused
+        void *block = pool_block_deref(pool, handles[7]);
+        pool_block_free_handle(pool, handles[7]);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_block_deref(pool, handles[7]) == NULL);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        pool_block_free_handle(pool, handles[7]);
+        assert(pool_last_error == POOL_INVALID_PTR);
+
+        PoolHandle reused = pool_block_alloc_handle(pool);
+        assert(reused != handles[7] && pool_block_deref(pool, reused) == block);
+        assert(pool_block_deref(pool, handles[7]) == NULL);
+
+        // Blocks freed by pointer and by cleanup
+        pool_block_free(pool, pool_block_deref(pool, handles[3]));
+        assert(pool_block_deref(pool, handles[3]) == NULL);
+        pool_block_clear(pool);
+        assert(pool_block_deref(pool, handles[0]) == NULL);
+        assert(pool_block_deref(pool, reused) == NULL);
+        PoolHandle fresh = pool_block_alloc_handle(pool);
+        assert(fresh != handles[0] && pool_block_deref(pool, fresh) != NULL);
+
+        // Handles with an index beyond the capacity
+        assert(pool_block_deref(pool, (PoolHandle) capacity | (1u << 7)) == NULL);
+        assert(pool_block_deref(pool, POOL_NULL_HANDLE) == NULL);
+
+        pool_block_destroy(pool);
+    }
+
+    // Handles require a fixed-size pool
+    PoolBlockOptions growable = { .flags = POOL_BLOCK_HANDLES, .growth = POOL_GROW_DOUBLE };
+    PoolBlock *invalid = pool_block_create_ex(10, 8, &growable);
+    assert(invalid == NULL);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+
+    PoolBlock *plain = pool_block_create(10, 8);
+    PoolHandle handle = pool_block_alloc_handle(plain);
+    assert(handle == POOL_NULL_HANDLE);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+    assert(pool_block_deref(plain, 1) == NULL);
+    pool_block_destroy(plain);
+
+    printf("test_block_pool_handles: OK\n");
+}
+
+void test_block_pool_calloc(void)
+{
+    const size_t capacity = 200;
+    PoolBlockOptions layouts[] = {{ .flags = 0 }, { .flags = POOL_BLOCK_BITMAP }};
+
+    for (int l = 0; l < 2; ++l)
+    {
+        PoolBlock *pool = pool_block_create_ex(capacity, 40, &layouts[l]);
+        assert(pool != NULL);
+
+        // Recycled blocks are dirty
+        unsigned char *blocks[200];
+        for (size_t i = 0; i < 100; ++i)
+        {
+            blocks[i] = pool_block_alloc(pool);
+            memset(blocks[i], 0xFF, 40);
+        }
+        for (size_t i = 0; i < 100; i += 2)
+            pool_block_free(pool, blocks[i]);
+        void *zeroed = pool->slabs->zeroed;
+        assert(zeroed > (void *) blocks[99]);
+
+        for (size_t round = 0; round < 2; ++round)
+        {
+            for (size_t i = 0; i < capacity - 50; ++i)
+            {
+                blocks[i] = pool_block_calloc(pool);
+                assert(blocks[i] != NULL && pool_last_error == POOL_OK);
+                for (size_t j = 0; j < 40; ++j)
+                    assert(blocks[i][j] == 0);
+                memset(blocks[i], 0xFF, 40);
+            }
+            void *extra = pool_block_calloc(pool);
+            assert(extra == NULL);
+            assert(pool_last_error == POOL_ALLOC_FAILED);
+
+            // After the cleanup every block was allocated before
+            pool_block_clear(pool);
+            for (size_t i = 0; i < 50; ++i)
+                memset(pool_block_alloc(pool), 0xFF, 40);
+        }
+
+        pool_block_destroy(pool);
+    }
+
+    void *none = pool_block_calloc(NULL);
+    assert(none == NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+
+    printf("test_block_pool_calloc: OK\n");
+}
+
+void test_block_pool_huge_pages(void)
+{
+    PoolBlockOptions options = { .flags = POOL_BLOCK_HUGE_PAGES, .growth = POOL_GROW_FIXED,
+        .growth_step = 1000 };
+    PoolBlock *pool = pool_block_create_ex(1000, 64, &options);
+    assert(pool != NULL && pool_last_error == POOL_OK);
+
+    // The slab buffers start on a huge page, whatever backs them
+    unsigned char *blocks[1500];
+    for (size_t i = 0; i < 1500; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        assert(blocks[i] != NULL);
+        memset(blocks[i], (int) i, 40);
+    }
+    for (BlockSlab *slab = pool->slabs; slab; slab = slab->next)
+    {
+        assert((uintptr_t) slab->mem % POOL_PAGES_HUGE_SIZE == 0);
+        assert(slab->pages <= POOL_PAGES_THP);
+    }
+    for (size_t i = 0; i < 1500; ++i)
+    {
+        assert(blocks[i][39] == (unsigned char) i);
+        pool_block_free(pool, blocks[i]);
+    }
+    assert(pool_last_error == POOL_OK);
+
+    pool_block_destroy(pool);
+    printf("test_block_pool_huge_pages: OK\n");
+}
+
+// Tells if the page holding the address is in memory
+static bool page_resident(const void *addr)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    unsigned char vec;
+    assert(mincore((void *) ((uintptr_t) addr & ~(page - 1)), page, &vec) == 0);
+    return vec & 1;
+}
+
+void test_block_pool_trim(void)
+{
+    // Bitmap layout: the pages of free runs are released between busy blocks
+    PoolBlockOptions options = { .flags = POOL_BLOCK_BITMAP };
+    PoolBlock *pool = pool_block_create_ex(4096, 64, &options);
+    assert(pool != NULL);
+    unsigned char *blocks[4096];
+    for (size_t i = 0; i < 4096; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        memset(blocks[i], 0xAB, 64);
+    }
+    for (size_t i = 1; i < 4095; ++i)
+        pool_block_free(pool, blocks[i]);
+
+    size_t released = pool_block_trim(pool);
+    assert(pool_last_error == POOL_OK);
+    assert(released >= 4096 * 64 - 2 * 4096 && released < 4096 * 64);
+    assert(blocks[0][63] == 0xAB && blocks[4095][0] == 0xAB);
+    assert(!page_resident(blocks[2048]));
+
+    // The pages come back zero-filled on reuse
+    unsigned char *again = pool_block_calloc(pool);
+    assert(again != NULL && again[0] == 0 && again[63] == 0);
+    memset(again, 0xCD, 64);
+    assert(page_resident(again));
+    pool_block_destroy(pool);
+
+    // Header layout: an empty slab is rewound and released as a whole
+    pool = pool_block_create(1024, 64);
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        memset(blocks[i], 0xAB, 64);
+    }
+    for (size_t i = 0; i < 1024; ++i)
+        pool_block_free(pool, blocks[i]);
+    released = pool_block_trim(pool);
+    assert(released >= 1024 * 64);
+    assert(!page_resident(blocks[0]) && !page_resident(blocks[1023]));
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        assert(blocks[i] != NULL);
+    }
+    again = pool_block_alloc(pool);
+    assert(again == NULL);
+    pool_block_destroy(pool);
+
+    // A slab that becomes empty after a burst is trimmed automatically
+    PoolBlockOptions automatic = { .trim_threshold = 16 * 1024 };
+    pool = pool_block_create_ex(1024, 64, &automatic);
+    void *small = pool_block_alloc(pool);
+    memset(small, 0xAB, 64);
+    pool_block_free(pool, small);
+    assert(page_resident(small));
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        blocks[i] = pool_block_alloc(pool);
+        memset(blocks[i], 0xAB, 64);
+    }
+    for (size_t i = 0; i < 1024; ++i)
+        pool_block_free(pool, blocks[i]);
+    assert(!page_resident(blocks[512]));
+    assert(pool_block_size(pool) == 0);
+    again = pool_block_alloc(pool);
+    assert(again != NULL);
+    pool_block_destroy(pool);
+
+    released = pool_block_trim(NULL);
+    assert(released == 0 && pool_last_error == POOL_NULL_PTR);
+    printf("test_block_pool_trim: OK\n");
+}
@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pool_errors.h>
+#include <block_pool_typed.h>
+
+typedef struct {
+    int id;
+    double value;
+    char name[20];
+} Item;
+
+typedef struct {
+    _Alignas(64) float lanes[16];
+} Vector;
+
+POOL_BLOCK_DECLARE(ItemPool, Item, 4)
+POOL_BLOCK_DECLARE(VectorPool, Vector, 3)
+
+void test_block_pool_typed(void)
+{
+    ItemPool *pool = ItemPool_create();
+    assert(pool != NULL);
+    assert(((PoolBlock *) pool)->block_size == POOL_TYPED_BLOCK_SIZE(Item));
+
+    Item *items[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        items[i] = ItemPool_alloc(pool);
+        assert(items[i] != NULL);
+        assert(ItemPool_contains(pool, items[i]));
+        items[i]->id = i;
+    }
+    assert(pool_block_size((PoolBlock *) pool) == 4);
+
+    // The exhausted pool reports the error through the generic path
+    Item *extra = ItemPool_alloc(pool);
+    assert(extra == NULL && pool_last_error == POOL_ALLOC_FAILED);
+
+    // Freed blocks come back in LIFO order, also mixed with the generic functions
+    ItemPool_free(pool, items[1]);
+    assert(pool_last_error == POOL_OK);
+    pool_block_free((PoolBlock *) pool, items[2]);
+    Item *typed = ItemPool_alloc(pool);
+    void *generic = pool_block_alloc((PoolBlock *) pool);
+    assert(typed == items[2] && generic == (void *) items[1]);
+    assert(items[0]->id == 0 && items[3]->id == 3);
+
+    // Invalid pointers are rejected
+    ItemPool_free(pool, items[3]);
+    ItemPool_free(pool, items[3]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    ItemPool_free(pool, (Item *) ((char *) items[0] + 8));
+    assert(pool_last_error == POOL_INVALID_PTR);
+    assert(!ItemPool_contains(pool, (Item *) ((char *) items[0] + 8)));
+    ItemPool_free(pool, NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+    assert(pool_block_size((PoolBlock *) pool) == 3);
+
+    ItemPool_clear(pool);
+    for (int i = 0; i < 4; ++i)
+    {
+        items[i] = ItemPool_alloc(pool);
+        assert(items[i] != NULL);
+    }
+    ItemPool_destroy(pool);
+
+    // Over-aligned types get aligned blocks
+    VectorPool *vectors = VectorPool_create();
+    assert(vectors != NULL);
+    for (int i = 0; i < 3; ++i)
+    {
+        Vector *v = VectorPool_alloc(vectors);
+        assert(v != NULL && (uintptr_t) v % 64 == 0);
+    }
+    VectorPool_destroy(vectors);
+
+    printf("test_block_pool_typed: OK\n");
+}
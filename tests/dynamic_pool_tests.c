@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <dynamic_pool.h>
 #include <pool_errors.h>
 
@@ -107,57 +111,58 @@ void test_dynamic_pool_alignment()
 
 void test_dynamic_pool_coalesce(void)
 {
-    PoolDyn *pool = pool_dyn_create(256);
+    PoolDyn *pool = pool_dyn_create(512);
     assert(pool != NULL);
 
     // Create many small sized blocks
-    void *block_1 = pool_dyn_alloc(pool, 32);
-    assert(block_1 != NULL);
-
-    void *block_2 = pool_dyn_alloc(pool, 32);
-    assert(block_2 != NULL);
-
-    void *block_3 = pool_dyn_alloc(pool, 32);
-    assert(block_3 != NULL);
+    void *blocks[6];
+    for (size_t i = 0; i < 6; ++i)
+    {
+        blocks[i] = pool_dyn_alloc(pool, 32);
+        assert(blocks[i] != NULL);
+    }
 
-    void *block_4 = pool_dyn_alloc(pool, 32);
-    assert(block_4 != NULL);
+    // The rest of the pool is taken too
+    void *tail = pool_dyn_alloc(pool, pool_dyn_capacity(pool) - pool_dyn_size(pool) -
+            sizeof(MetaData));
+    assert(tail != NULL);
 
-    void *block_5 = pool_dyn_alloc(pool, 32);
-    assert(block_5 != NULL);
+    // We free 3 consecutive blocks, the middle one last.
+    pool_dyn_free(pool, blocks[2]);
+    pool_dyn_free(pool, blocks[4]);
+    pool_dyn_free(pool, blocks[3]);
+    assert(pool_last_error == POOL_OK);
 
-    void *block_6 = pool_dyn_alloc(pool, 16);
-    assert(block_6 != NULL);
+    // They are merged at once into a block starting at the first one
+    MetaData *block_3_meta = (MetaData *) (blocks[2] - sizeof(MetaData));
+    assert(block_3_meta->canary == CANARY_FREE);
+    assert(block_3_meta->size == 3 * 32 + 2 * sizeof(MetaData));
+    assert(block_3_meta->next_block->prev_block == block_3_meta);
 
-    // We free 3 consecutive blocks.
-    pool_dyn_free(pool, block_3);
-    pool_dyn_free(pool, block_4);
-    pool_dyn_free(pool, block_5);
+    // A merged block can not be freed again
+    pool_dyn_free(pool, blocks[3]);
+    assert(pool_last_error == POOL_INVALID_PTR);
 
-    // Trying to allocate a large block.
     void *block_l = pool_dyn_alloc(pool, 128);
-    assert(block_l == NULL);
-
-    // We run the free block merging function and try to
-    // allocate a large block again
-    coalesce_free_blocks(pool);
-
-    MetaData *block_3_meta = (MetaData *) (block_3 - sizeof(MetaData));
-    block_l = pool_dyn_alloc(pool, 128);
-    assert(block_l != NULL);
+    assert(block_l == blocks[2]);
 
-    // Freeing up 2 more blocks
-    pool_dyn_free(pool, block_1);
-    pool_dyn_free(pool, block_2);
-
-    // The pool is fragmented, we can't allocate a large block
+    // Freeing up 2 more blocks, they are merged as well
+    pool_dyn_free(pool, blocks[0]);
+    pool_dyn_free(pool, blocks[1]);
     void *block_ll = pool_dyn_alloc(pool, 64);
-    assert(block_ll == NULL);
+    assert(block_ll == blocks[0]);
+
+    // Nothing is left to merge
+    coalesce_free_blocks(pool);
+    assert(pool_last_error == POOL_OK);
 
-    // pool_dyn_alloc_safe function will try to automatically merge
-    // free blocks and retry block allocation
-    block_ll = pool_dyn_alloc_safe(pool, 64);
-    assert(block_ll != NULL);
+    // Once everything is released the pool is one free block again
+    pool_dyn_free(pool, block_l);
+    pool_dyn_free(pool, tail);
+    pool_dyn_free(pool, blocks[5]);
+    pool_dyn_free(pool, block_ll);
+    assert(pool_dyn_size(pool) == sizeof(MetaData));
+    assert(((MetaData *) pool->mem_pool)->next_block == NULL);
 
     pool_dyn_destroy(pool);
     assert(pool_last_error == POOL_OK);
@@ -217,3 +222,897 @@ void test_dynamic_pool_block_recovery(void)
     pool_dyn_destroy(pool);
     printf("test_dynamic_pool_block_recovery: OK\n");
 }
+
+void test_dynamic_pool_aligned(void)
+{
+    const size_t alignments[] = {16, 32, 64, 4096};
+    for (size_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); ++a)
+    {
+        PoolDyn *pool = pool_dyn_create_aligned(16 * 1024, alignments[a]);
+        assert(pool != NULL);
+
+        void *blocks[6];
+        const size_t sizes[] = {1, 24, 100, 64, 300, 8};
+        for (int i = 0; i < 6; ++i)
+        {
+            blocks[i] = pool_dyn_alloc(pool, sizes[i]);
+            assert(blocks[i] != NULL);
+            assert((uintptr_t) blocks[i] % alignments[a] == 0);
+        }
+
+        // Merged free blocks keep the following payloads aligned
+        pool_dyn_free(pool, blocks[1]);
+        pool_dyn_free(pool, blocks[2]);
+        assert(pool_last_error == POOL_OK);
+        coalesce_free_blocks(pool);
+        void *merged = pool_dyn_alloc(pool, 40);
+        assert(merged != NULL && (uintptr_t) merged % alignments[a] == 0);
+
+        pool_dyn_free(pool, (char *) blocks[3] + 8);
+        assert(pool_last_error == POOL_INVALID_PTR);
+
+        pool_dyn_destroy(pool);
+    }
+
+    PoolDyn *invalid = pool_dyn_create_aligned(1024, 4);
+    assert(invalid == NULL && pool_last_error == POOL_INVALID_ARGS);
+    invalid = pool_dyn_create_aligned(1024, 48);
+    assert(invalid == NULL);
+    invalid = pool_dyn_create_aligned(1024, 8192);
+    assert(invalid == NULL);
+
+    printf("test_dynamic_pool_aligned: OK\n");
+}
+
+void test_dynamic_pool_tlsf(void)
+{
+    PoolDynOptions options = { .flags = POOL_DYN_TLSF };
+    PoolDyn *pool = pool_dyn_create_ex(16384, &options);
+    assert(pool != NULL && pool->tlsf != NULL && pool_last_error == POOL_OK);
+
+    // Blocks of various sizes keep their contents
+    unsigned char *blocks[64];
+    for (size_t i = 0; i < 64; ++i)
+    {
+        size_t size = 8 + (i * 37) % 200;
+        blocks[i] = pool_dyn_alloc(pool, size);
+        assert(blocks[i] != NULL && pool_last_error == POOL_OK);
+        assert((uintptr_t) blocks[i] % ALIGNMENT == 0);
+        for (size_t j = 0; j < size; ++j)
+            blocks[i][j] = (unsigned char) i;
+    }
+    for (size_t i = 0; i < 64; ++i)
+        for (size_t j = 0; j < 8 + (i * 37) % 200; ++j)
+            assert(blocks[i][j] == (unsigned char) i);
+
+    // A freed block is reused by a request of the same size
+    void *freed = blocks[10];
+    pool_dyn_free(pool, blocks[10]);
+    assert(pool_last_error == POOL_OK);
+    pool_dyn_free(pool, blocks[10]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    blocks[10] = pool_dyn_alloc(pool, 8 + (10 * 37) % 200);
+    assert(blocks[10] == freed);
+
+    // Released from the end, every block merges with the free tail
+    for (size_t i = 64; i > 0; --i)
+        pool_dyn_free(pool, blocks[i - 1]);
+    assert(pool_dyn_size(pool) == sizeof(MetaData));
+    void *whole = pool_dyn_alloc(pool, pool_dyn_capacity(pool) - sizeof(MetaData));
+    assert(whole != NULL);
+    pool_dyn_free(pool, whole);
+
+    // Released from the start, the blocks are merged as well
+    size_t count = 0;
+    while ((blocks[count] = pool_dyn_alloc(pool, 1000)))
+        ++count;
+    assert(count > 4);
+    for (size_t i = 0; i < count; ++i)
+        pool_dyn_free(pool, blocks[i]);
+    assert(pool_dyn_size(pool) == sizeof(MetaData));
+    void *merged = pool_dyn_alloc(pool, 4000);
+    assert(merged != NULL);
+
+    // Damaged metadata is restored on release
+    pool_dyn_clear(pool);
+    void *block = pool_dyn_alloc(pool, 32);
+    ((MetaData *) (block - sizeof(MetaData)))->canary = 0xDEADBEEF;
+    pool_dyn_free(pool, block);
+    assert(pool_last_error == POOL_OK);
+    assert(pool_dyn_size(pool) == sizeof(MetaData));
+
+    pool_dyn_destroy(pool);
+
+    // The index works with aligned blocks
+    options.alignment = 64;
+    pool = pool_dyn_create_ex(4096, &options);
+    assert(pool != NULL);
+    for (size_t i = 0; i < 16; ++i)
+    {
+        blocks[i] = pool_dyn_alloc(pool, 1 + i * 13);
+        assert(blocks[i] != NULL && (uintptr_t) blocks[i] % 64 == 0);
+    }
+    for (size_t i = 0; i < 16; i += 2)
+        pool_dyn_free(pool, blocks[i]);
+    for (size_t i = 0; i < 16; i += 2)
+    {
+        blocks[i] = pool_dyn_alloc(pool, 1 + i * 13);
+        assert((uintptr_t) blocks[i] % 64 == 0);
+    }
+    pool_dyn_destroy(pool);
+
+    printf("test_dynamic_pool_tlsf: OK\n");
+}
+
+void test_dynamic_pool_realloc(void)
+{
+    PoolDynOptions modes[] = {{ .flags = 0 }, { .flags = POOL_DYN_TLSF }};
+
+    for (int m = 0; m < 2; ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(4096, &modes[m]);
+        assert(pool != NULL);
+
+        unsigned char *a = pool_dyn_realloc(pool, NULL, 64);
+        assert(a != NULL && pool_last_error == POOL_OK);
+        for (size_t i = 0; i < 64; ++i)
+            a[i] = (unsigned char) i;
+
+        // The block grows into the free block behind it
+        void *b = pool_dyn_alloc(pool, 64);
+        pool_dyn_free(pool, b);
+        unsigned char *resized = pool_dyn_realloc(pool, a, 200);
+        assert(resized == a);
+        assert(((MetaData *) ((void *) a - sizeof(MetaData)))->size >= 200);
+
+        // It shrinks in place, the tail becomes a free block
+        resized = pool_dyn_realloc(pool, a, 16);
+        assert(resized == a);
+        assert(pool_dyn_size(pool) == 2 * sizeof(MetaData) + 16);
+        unsigned char *c = pool_dyn_alloc(pool, 100);
+        assert(c == a + 16 + sizeof(MetaData));
+        for (size_t i = 0; i < 16; ++i)
+            assert(a[i] == (unsigned char) i);
+
+        // The block behind is busy, the contents move
+        unsigned char *moved = pool_dyn_realloc(pool, a, 500);
+        assert(moved != NULL && moved != a);
+        for (size_t i = 0; i < 16; ++i)
+            assert(moved[i] == (unsigned char) i);
+
+        // Failed growth leaves the block unchanged
+        resized = pool_dyn_realloc(pool, moved, 100000);
+        assert(resized == NULL);
+        assert(pool_last_error == POOL_ALLOC_FAILED);
+        assert(moved[15] == 15);
+
+        // Invalid pointers
+        resized = pool_dyn_realloc(pool, a, 32);
+        assert(resized == NULL);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        resized = pool_dyn_realloc(pool, moved + 1, 32);
+        assert(resized == NULL);
+        assert(pool_last_error == POOL_INVALID_PTR);
+
+        // Size 0 frees the memory
+        resized = pool_dyn_realloc(pool, moved, 0);
+        assert(resized == NULL && pool_last_error == POOL_OK);
+        pool_dyn_free(pool, c);
+        assert(pool_dyn_size(pool) == sizeof(MetaData));
+
+        pool_dyn_destroy(pool);
+    }
+
+    printf("test_dynamic_pool_realloc: OK\n");
+}
+
+void test_dynamic_pool_alloc_aligned(void)
+{
+    PoolDynOptions modes[] = {{ .flags = 0 }, { .flags = POOL_DYN_TLSF }};
+    const size_t alignments[] = {16, 64, 256, 4096};
+
+    for (int m = 0; m < 2; ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(32768, &modes[m]);
+        assert(pool != NULL);
+
+        for (size_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); ++a)
+        {
+            // The payload behind a small block is not aligned
+            void *small = pool_dyn_alloc(pool, 8);
+            size_t size = pool_dyn_size(pool);
+
+            void *block = pool_dyn_alloc_aligned(pool, 100, alignments[a]);
+            assert(block != NULL && pool_last_error == POOL_OK);
+            assert((uintptr_t) block % alignments[a] == 0);
+            memset(block, 0xAB, 100);
+
+            // The gap in front of the block is a reusable free block
+            MetaData *gap = ((MetaData *) (block - sizeof(MetaData)))->prev_block;
+            if (gap != small - sizeof(MetaData))
+            {
+                assert(gap != NULL && gap->canary == CANARY_FREE);
+                assert((void *) gap + sizeof(MetaData) + gap->size == block - sizeof(MetaData));
+                assert(pool_dyn_size(pool) == size + 2 * sizeof(MetaData) +
+                        ((MetaData *) (block - sizeof(MetaData)))->size);
+                if (!pool->tlsf)
+                {
+                    void *reused = pool_dyn_alloc(pool, gap->size);
+                    assert(reused == (void *) gap + sizeof(MetaData));
+                }
+            }
+
+            pool_dyn_clear(pool);
+        }
+
+        // Released blocks merge back into the whole pool
+        void *blocks[8];
+        for (size_t i = 0; i < 8; ++i)
+        {
+            blocks[i] = pool_dyn_alloc_aligned(pool, 24 + i * 40, 64);
+            assert(blocks[i] != NULL && (uintptr_t) blocks[i] % 64 == 0);
+        }
+        for (size_t i = 0; i < 8; ++i)
+            pool_dyn_free(pool, blocks[i]);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_dyn_size(pool) == sizeof(MetaData));
+
+        // Small alignments are served by the ordinary allocation
+        void *aligned = pool_dyn_alloc_aligned(pool, 10, 8);
+        assert(aligned == pool->mem_pool + sizeof(MetaData));
+
+        aligned = pool_dyn_alloc_aligned(pool, 10, 48);
+        assert(aligned == NULL);
+        assert(pool_last_error == POOL_INVALID_ARGS);
+        aligned = pool_dyn_alloc_aligned(pool, 10, 8192);
+        assert(aligned == NULL);
+        assert(pool_last_error == POOL_INVALID_ARGS);
+        aligned = pool_dyn_alloc_aligned(pool, 100000, 64);
+        assert(aligned == NULL);
+        assert(pool_last_error == POOL_ALLOC_FAILED);
+
+        pool_dyn_destroy(pool);
+    }
+
+    printf("test_dynamic_pool_alloc_aligned: OK\n");
+}
+
+void test_dynamic_pool_calloc(void)
+{
+    PoolDynOptions modes[] = {{ .flags = 0 }, { .flags = POOL_DYN_TLSF },
+        { .flags = POOL_DYN_COMPACT }, { .flags = POOL_DYN_COMPACT | POOL_DYN_TLSF }};
+
+    for (int m = 0; m < 4; ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(8192, &modes[m]);
+        assert(pool != NULL);
+
+        // Dirty blocks with metadata of free blocks between them
+        unsigned char *blocks[32];
+        for (size_t i = 0; i < 32; ++i)
+        {
+            blocks[i] = pool_dyn_alloc(pool, 16 + i * 8);
+            memset(blocks[i], 0xFF, 16 + i * 8);
+        }
+        for (size_t i = 0; i < 32; i += 3)
+            pool_dyn_free(pool, blocks[i]);
+        assert(pool->zeroed < pool->mem_pool + pool_dyn_capacity(pool));
+
+        // Requests are served partly from the dirty part, partly above it
+        for (size_t i = 0; i < 40; ++i)
+        {
+            size_t size = 8 + (i * 53) % 300;
+            unsigned char *block = pool_dyn_calloc(pool, size);
+            if (!block)
+                break;
+            for (size_t j = 0; j < size; ++j)
+                assert(block[j] == 0);
+            memset(block, 0xFF, size);
+        }
+
+        pool_dyn_clear(pool);
+        size_t size = pool_dyn_capacity(pool) - pool->header_size;
+        unsigned char *whole = pool_dyn_calloc(pool, size);
+        assert(whole != NULL);
+        for (size_t j = 0; j < size; ++j)
+            assert(whole[j] == 0);
+
+        pool_dyn_destroy(pool);
+    }
+
+    void *none = pool_dyn_calloc(NULL, 8);
+    assert(none == NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+
+    printf("test_dynamic_pool_calloc: OK\n");
+}
+
+void test_dynamic_pool_compact(void)
+{
+    PoolDynOptions modes[] = {{ .flags = POOL_DYN_COMPACT },
+        { .flags = POOL_DYN_COMPACT | POOL_DYN_TLSF }};
+
+    for (int m = 0; m < 2; ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(16384, &modes[m]);
+        assert(pool != NULL && pool_last_error == POOL_OK);
+        assert(pool->header_size == sizeof(DynHeader));
+        assert(pool_dyn_size(pool) == sizeof(DynHeader));
+
+        // Small blocks take 8 bytes of header
+        unsigned char *blocks[64];
+        for (size_t i = 0; i < 64; ++i)
+        {
+            size_t size = 8 + (i * 37) % 200;
+            blocks[i] = pool_dyn_alloc(pool, size);
+            assert(blocks[i] != NULL && pool_last_error == POOL_OK);
+            assert((uintptr_t) blocks[i] % ALIGNMENT == 0);
+            memset(blocks[i], (int) i, size);
+        }
+        assert(blocks[1] == blocks[0] + pool->min_block + sizeof(DynHeader));
+        for (size_t i = 0; i < 64; ++i)
+            for (size_t j = 0; j < 8 + (i * 37) % 200; ++j)
+                assert(blocks[i][j] == (unsigned char) i);
+
+        // A block is merged with the free blocks on both sides
+        pool_dyn_free(pool, blocks[10]);
+        pool_dyn_free(pool, blocks[12]);
+        pool_dyn_free(pool, blocks[11]);
+        assert(pool_last_error == POOL_OK);
+        size_t merged = (blocks[13] - blocks[10]) - sizeof(DynHeader);
+        assert((*(DynHeader *) (blocks[10] - sizeof(DynHeader)) & DYN_SIZE_MASK) == merged);
+        void *again = pool_dyn_alloc(pool, merged);
+        assert(again != NULL);
+        if (!pool->tlsf)
+            assert(again == blocks[10]);
+        blocks[10] = again;
+
+        // Double release is detected by the free bit
+        pool_dyn_free(pool, blocks[20]);
+        pool_dyn_free(pool, blocks[20]);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        pool_dyn_free(pool, blocks[21]);
+        pool_dyn_free(pool, blocks[21]);
+        assert(pool_last_error == POOL_INVALID_PTR);
+
+        // Growth in place, shrinking and moving keep the contents
+        unsigned char *grown = pool_dyn_realloc(pool, blocks[19], 150);
+        assert(grown == blocks[19]);
+        for (size_t j = 0; j < 8 + (19 * 37) % 200; ++j)
+            assert(grown[j] == 19);
+        unsigned char *shrunk = pool_dyn_realloc(pool, grown, 8);
+        assert(shrunk == grown);
+        unsigned char *moved = pool_dyn_realloc(pool, blocks[30], 1000);
+        assert(moved != NULL && moved != blocks[30]);
+        for (size_t j = 0; j < 8 + (30 * 37) % 200; ++j)
+            assert(moved[j] == 30);
+        blocks[30] = moved;
+
+        // Aligned blocks leave a free gap in front of them
+        void *aligned = pool_dyn_alloc_aligned(pool, 100, 256);
+        assert(aligned != NULL && (uintptr_t) aligned % 256 == 0);
+        pool_dyn_free(pool, aligned);
+
+        // Released blocks merge back into the whole pool
+        for (size_t i = 0; i < 64; ++i)
+            if (i < 11 || i > 12)
+                if (i != 20 && i != 21)
+                    pool_dyn_free(pool, blocks[i]);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_dyn_size(pool) == sizeof(DynHeader));
+        void *whole = pool_dyn_alloc(pool, pool_dyn_capacity(pool) - sizeof(DynHeader));
+        assert(whole == pool->mem_pool + sizeof(DynHeader));
+
+        pool_dyn_clear(pool);
+        assert(pool_dyn_size(pool) == sizeof(DynHeader));
+        pool_dyn_destroy(pool);
+    }
+
+    printf("test_dynamic_pool_compact: OK\n");
+}
+
+void test_dynamic_pool_integrity(void)
+{
+    const PoolDynIntegrity levels[] = {POOL_DYN_INTEGRITY_NONE, POOL_DYN_INTEGRITY_CANARY,
+        POOL_DYN_INTEGRITY_CHECKSUM};
+
+    for (size_t l = 0; l < 3; ++l)
+    for (unsigned int flags = 0; flags <= POOL_DYN_TLSF; flags += POOL_DYN_TLSF)
+    {
+        PoolDynOptions options = { .flags = flags, .integrity = levels[l] };
+        PoolDyn *pool = pool_dyn_create_ex(4096, &options);
+        assert(pool != NULL && pool->integrity == levels[l]);
+
+        void *blocks[16];
+        for (size_t i = 0; i < 16; ++i)
+        {
+            blocks[i] = pool_dyn_alloc(pool, 16 + i * 8);
+            assert(blocks[i] != NULL);
+        }
+        for (size_t i = 0; i < 16; i += 2)
+            pool_dyn_free(pool, blocks[i]);
+        for (size_t i = 1; i < 16; i += 2)
+            pool_dyn_free(pool, blocks[i]);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_dyn_size(pool) == sizeof(MetaData));
+
+        // The checksum replaces the end canary and covers every header field
+        void *a = pool_dyn_alloc(pool, 32);
+        void *b = pool_dyn_alloc(pool, 32);
+        MetaData *a_meta = a - sizeof(MetaData);
+        if (levels[l] == POOL_DYN_INTEGRITY_CHECKSUM)
+        {
+            assert(a_meta->end_canary != END_CANARY);
+            a_meta->size = 100000;
+            pool_dyn_free(pool, a);
+            assert(pool_last_error == POOL_OK);
+        }
+        else
+            pool_dyn_free(pool, a);
+        pool_dyn_free(pool, b);
+        assert(pool_dyn_size(pool) == sizeof(MetaData));
+
+        pool_dyn_destroy(pool);
+    }
+
+    // The default level is POOL_DYN_DEFAULT_INTEGRITY
+    PoolDyn *pool = pool_dyn_create(1024);
+    assert(pool != NULL && pool->integrity == POOL_DYN_DEFAULT_INTEGRITY);
+    pool_dyn_destroy(pool);
+
+    // Compact headers have no room for the checks
+    PoolDynOptions options = { .flags = POOL_DYN_COMPACT, .integrity = POOL_DYN_INTEGRITY_CANARY };
+    pool = pool_dyn_create_ex(1024, &options);
+    assert(pool == NULL);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+    options.integrity = POOL_DYN_INTEGRITY_NONE;
+    pool = pool_dyn_create_ex(1024, &options);
+    assert(pool != NULL);
+    pool_dyn_destroy(pool);
+    options = (PoolDynOptions) { .integrity = POOL_DYN_INTEGRITY_CHECKSUM + 1 };
+    pool = pool_dyn_create_ex(1024, &options);
+    assert(pool == NULL);
+    assert(pool_last_error == POOL_INVALID_ARGS);
+
+    printf("test_dynamic_pool_integrity: OK\n");
+}
+
+void test_dynamic_pool_huge_pages(void)
+{
+    PoolDynOptions options = { .flags = POOL_DYN_HUGE_PAGES | POOL_DYN_TLSF };
+    PoolDyn *pool = pool_dyn_create_ex(3 << 20, &options);
+    assert(pool != NULL && pool_last_error == POOL_OK);
+    assert((uintptr_t) pool->raw % POOL_PAGES_HUGE_SIZE == 0);
+    assert(pool->pages <= POOL_PAGES_THP);
+
+    unsigned char *blocks[64];
+    for (size_t i = 0; i < 64; ++i)
+    {
+        blocks[i] = pool_dyn_alloc(pool, 1000 + i * 500);
+        assert(blocks[i] != NULL);
+        memset(blocks[i], (int) i, 1000 + i * 500);
+    }
+    for (size_t i = 0; i < 64; ++i)
+    {
+        assert(blocks[i][999 + i * 500] == (unsigned char) i);
+        pool_dyn_free(pool, blocks[i]);
+    }
+    assert(pool_dyn_size(pool) == sizeof(MetaData));
+    pool_dyn_destroy(pool);
+
+    /**
+     * A block may exceed 4 GiB. The memory is only reserved, the check is
+     * skipped where the system refuses to map that much.
+     */
+    const size_t huge = ((size_t) 4 << 30) + 4096;
+    pool = pool_dyn_create(huge);
+    if (pool)
+    {
+        unsigned char *block = pool_dyn_alloc(pool, huge);
+        assert(block != NULL);
+        assert(((MetaData *) (block - sizeof(MetaData)))->size >= huge);
+        block[0] = 1;
+        block[huge - 1] = 2;
+        pool_dyn_free(pool, block);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_dyn_size(pool) == sizeof(MetaData));
+        pool_dyn_destroy(pool);
+    }
+
+    printf("test_dynamic_pool_huge_pages: OK\n");
+}
+
+void test_dynamic_pool_growth(void)
+{
+    // Invalid growth policies
+    PoolDynOptions options = { .growth = POOL_DYN_GROW_FIXED };
+    PoolDyn *invalid = pool_dyn_create_ex(4096, &options);
+    assert(invalid == NULL && pool_last_error == POOL_INVALID_ARGS);
+    options.growth = POOL_DYN_GROW_FIXED + 1;
+    invalid = pool_dyn_create_ex(4096, &options);
+    assert(invalid == NULL && pool_last_error == POOL_INVALID_ARGS);
+
+    const PoolDynOptions modes[] = {
+        { .growth = POOL_DYN_GROW_DOUBLE },
+        { .flags = POOL_DYN_TLSF, .growth = POOL_DYN_GROW_DOUBLE },
+        { .flags = POOL_DYN_COMPACT, .growth = POOL_DYN_GROW_FIXED, .growth_step = 8192 },
+        { .flags = POOL_DYN_TLSF, .integrity = POOL_DYN_INTEGRITY_CHECKSUM,
+            .growth = POOL_DYN_GROW_FIXED, .growth_step = 8192 }};
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        // The first arena is sized exactly, up to the end of its last page
+        PoolDyn *pool = pool_dyn_create_ex(4000, &modes[m]);
+        assert(pool != NULL && pool_last_error == POOL_OK);
+        assert(pool_dyn_capacity(pool) >= 4000 && pool_dyn_capacity(pool) <= 4096);
+        const size_t first_capacity = pool_dyn_capacity(pool);
+
+        // Allocation goes on beyond the first arena
+        unsigned char *blocks[256];
+        for (size_t i = 0; i < 256; ++i)
+        {
+            blocks[i] = pool_dyn_alloc(pool, 64 + i % 7 * 40);
+            assert(blocks[i] != NULL && pool_last_error == POOL_OK);
+            memset(blocks[i], (int) i, 64 + i % 7 * 40);
+        }
+        assert(pool->next_arena != NULL);
+        assert(pool_dyn_capacity(pool) > first_capacity);
+        assert(pool_dyn_size(pool) <= pool_dyn_capacity(pool));
+
+        // A request larger than any arena gets an arena of its own
+        unsigned char *large = pool_dyn_calloc(pool, 100000);
+        assert(large != NULL && large[0] == 0 && large[99999] == 0);
+        unsigned char *aligned = pool_dyn_alloc_aligned(pool, 3000, 4096);
+        assert(aligned != NULL && (uintptr_t) aligned % 4096 == 0);
+
+        // The blocks moved by realloc keep their contents
+        blocks[0] = pool_dyn_realloc(pool, blocks[0], 20000);
+        assert(blocks[0] != NULL && blocks[0][63] == 0);
+
+        // The blocks are found in their arenas
+        for (size_t i = 0; i < 256; ++i)
+        {
+            assert(blocks[i][63] == (unsigned char) i);
+            pool_dyn_free(pool, blocks[i]);
+            assert(pool_last_error == POOL_OK);
+        }
+        pool_dyn_free(pool, blocks[1]);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        int dummy;
+        pool_dyn_free(pool, &dummy);
+        assert(pool_last_error == POOL_INVALID_PTR);
+        pool_dyn_free(pool, large);
+        pool_dyn_free(pool, aligned);
+        assert(pool_last_error == POOL_OK);
+
+        // All but one of the empty added arenas are released
+        size_t arenas = 0;
+        for (PoolDyn *arena = pool->next_arena; arena; arena = arena->next_arena)
+        {
+            assert(arena->size == arena->header_size);
+            ++arenas;
+        }
+        assert(arenas == 1);
+        assert(pool->size == pool->header_size);
+
+        // Clearing keeps only the first arena
+        void *grown = pool_dyn_alloc(pool, 10000);
+        assert(grown != NULL);
+        pool_dyn_clear(pool);
+        assert(pool->next_arena == NULL && pool_dyn_capacity(pool) == first_capacity);
+        pool_dyn_destroy(pool);
+    }
+
+    // A pool that cannot grow still gets the room for the headers
+    PoolDyn *fixed = pool_dyn_create(4000);
+    assert(fixed != NULL && pool_dyn_capacity(fixed) >= (size_t) (4000 * ADVANCE));
+    void *too_large = pool_dyn_alloc(fixed, 8000);
+    assert(too_large == NULL && pool_last_error == POOL_ALLOC_FAILED);
+    pool_dyn_destroy(fixed);
+
+    printf("test_dynamic_pool_growth: OK\n");
+}
+
+// Tells if the page holding the address is in memory
+static bool page_resident(const void *addr)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    unsigned char vec;
+    assert(mincore((void *) ((uintptr_t) addr & ~(page - 1)), page, &vec) == 0);
+    return vec & 1;
+}
+
+void test_dynamic_pool_trim(void)
+{
+    const size_t big = 512 * 1024;
+    const PoolDynOptions modes[] = {
+        { .flags = 0 },
+        { .flags = POOL_DYN_TLSF },
+        { .flags = POOL_DYN_COMPACT | POOL_DYN_TLSF },
+        { .flags = POOL_DYN_TLSF, .growth = POOL_DYN_GROW_DOUBLE }};
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(big + 4096, &modes[m]);
+        assert(pool != NULL);
+
+        // The pages inside a free block are released, its neighbours keep theirs
+        unsigned char *first = pool_dyn_alloc(pool, 64);
+        unsigned char *block = pool_dyn_alloc(pool, big);
+        unsigned char *last = pool_dyn_alloc(pool, 64);
+        assert(first && block && last);
+        memset(first, 0x11, 64);
+        memset(block, 0xAB, big);
+        memset(last, 0x22, 64);
+        pool_dyn_free(pool, block);
+        assert(page_resident(block + big / 2));
+
+        size_t released = pool_dyn_trim(pool);
+        assert(pool_last_error == POOL_OK);
+        assert(released >= big - 2 * 4096);
+        assert(!page_resident(block + big / 2));
+        assert(first[63] == 0x11 && last[0] == 0x22);
+
+        // The free block is still whole and merges with its neighbours
+        pool_dyn_free(pool, first);
+        pool_dyn_free(pool, last);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_dyn_size(pool) == pool->header_size);
+
+        // The pages come back on reuse
+        unsigned char *zeroed = pool_dyn_calloc(pool, big);
+        assert(zeroed != NULL && zeroed[0] == 0 && zeroed[big / 2] == 0 && zeroed[big - 1] == 0);
+        memset(zeroed, 0xCD, big);
+        assert(page_resident(zeroed + big / 2));
+        pool_dyn_destroy(pool);
+    }
+
+    // Free blocks of the threshold size are trimmed as soon as they form
+    PoolDynOptions automatic = { .flags = POOL_DYN_COMPACT, .trim_threshold = 64 * 1024 };
+    PoolDyn *pool = pool_dyn_create_ex(big, &automatic);
+    unsigned char *small = pool_dyn_alloc(pool, 32 * 1024);
+    unsigned char *block = pool_dyn_alloc(pool, 256 * 1024);
+    unsigned char *guard = pool_dyn_alloc(pool, 64);
+    memset(small, 0xAB, 32 * 1024);
+    memset(block, 0xAB, 256 * 1024);
+    pool_dyn_free(pool, block);
+    assert(!page_resident(block + 128 * 1024));
+    pool_dyn_free(pool, guard);
+    assert(page_resident(small + 16 * 1024));
+    pool_dyn_free(pool, small);
+    assert(!page_resident(small + 16 * 1024));
+    assert(pool_last_error == POOL_OK && pool_dyn_size(pool) == pool->header_size);
+    pool_dyn_destroy(pool);
+
+    size_t released = pool_dyn_trim(NULL);
+    assert(released == 0 && pool_last_error == POOL_NULL_PTR);
+    printf("test_dynamic_pool_trim: OK\n");
+}
+
+#define STEP_PAIRS 64
+
+/**
+ * Leaves pairs of adjacent free blocks, separated by busy guards: the
+ * first block of a pair is damaged while the second one is released,
+ * then repaired.
+ */
+static void make_free_pairs(PoolDyn *pool, void **guards)
+{
+    void *firsts[STEP_PAIRS], *seconds[STEP_PAIRS];
+    for (size_t i = 0; i < STEP_PAIRS; ++i)
+    {
+        firsts[i] = pool_dyn_alloc(pool, 32);
+        seconds[i] = pool_dyn_alloc(pool, 32);
+        guards[i] = pool_dyn_alloc(pool, 32);
+        assert(firsts[i] && seconds[i] && guards[i]);
+    }
+    for (size_t i = 0; i < STEP_PAIRS; ++i)
+    {
+        MetaData *meta = firsts[i] - sizeof(MetaData);
+        pool_dyn_free(pool, firsts[i]);
+        meta->canary = 0;
+        pool_dyn_free(pool, seconds[i]);
+        meta->canary = CANARY_FREE;
+    }
+}
+
+void test_dynamic_pool_coalesce_step(void)
+{
+    const PoolDynOptions modes[] = {
+        { .flags = 0 },
+        { .flags = POOL_DYN_TLSF },
+        { .flags = POOL_DYN_TLSF, .growth = POOL_DYN_GROW_DOUBLE }};
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(modes[m].growth ? 2048 : 16 * 1024, &modes[m]);
+        assert(pool != NULL);
+        void *guards[STEP_PAIRS];
+        make_free_pairs(pool, guards);
+        size_t size = pool_dyn_size(pool);
+
+        // A small budget takes several steps, the pass resumes where it stopped
+        PoolDynBudget budget = { .blocks = 8 };
+        size_t steps = 1;
+        while (!pool_dyn_coalesce_step(pool, &budget))
+            ++steps;
+        assert(pool_last_error == POOL_OK);
+        assert(steps >= 3 * STEP_PAIRS / 8);
+        // A pair split between two arenas is not merged
+        if (!pool->next_arena)
+            assert(pool_dyn_size(pool) == size - STEP_PAIRS * sizeof(MetaData));
+        else
+            assert(pool_dyn_size(pool) < size - STEP_PAIRS / 2 * sizeof(MetaData));
+
+        // The merged blocks serve the requests of their size
+        void *merged = pool_dyn_alloc(pool, 32 + sizeof(MetaData) + 32);
+        assert(merged != NULL);
+        pool_dyn_free(pool, merged);
+
+        // A time budget ends the step too, no budget finishes the pass
+        PoolDynBudget quick = { .ns = 1 };
+        bool done = pool_dyn_coalesce_step(pool, &quick);
+        assert(!done);
+        done = pool_dyn_coalesce_step(pool, NULL);
+        assert(done);
+
+        // The pool may change between the steps, the cursor follows the merges
+        for (size_t i = 0; i < STEP_PAIRS; ++i)
+            pool_dyn_free(pool, guards[i]);
+        make_free_pairs(pool, guards);
+        size_t freed = 0;
+        while (!pool_dyn_coalesce_step(pool, &budget))
+            if (freed < STEP_PAIRS)
+                pool_dyn_free(pool, guards[freed++]);
+        while (freed < STEP_PAIRS)
+            pool_dyn_free(pool, guards[freed++]);
+        assert(pool_last_error == POOL_OK);
+        assert(pool->size == sizeof(MetaData));
+        pool_dyn_destroy(pool);
+    }
+
+    /**
+     * A block dropped from the index because of a damaged header is merged
+     * after the repair without touching the index lists it is not in
+     */
+    PoolDyn *pool = pool_dyn_create_ex(4096, &(PoolDynOptions) { .flags = POOL_DYN_TLSF });
+    assert(pool != NULL);
+    void *a = pool_dyn_alloc(pool, 32);
+    void *guard_a = pool_dyn_alloc(pool, 32);
+    void *c = pool_dyn_alloc(pool, 32);
+    void *x = pool_dyn_alloc(pool, 64);
+    void *guard_x = pool_dyn_alloc(pool, 32);
+    assert(a && guard_a && c && x && guard_x);
+    pool_dyn_free(pool, a);
+    pool_dyn_free(pool, c);
+    MetaData *meta = c - sizeof(MetaData);
+    meta->canary = 0;
+    pool_dyn_free(pool, x);
+    void *reused = pool_dyn_alloc(pool, 32);
+    assert(reused == a);
+    memset(a, 0x5A, 32);
+    meta->canary = CANARY_FREE;
+    bool done = pool_dyn_coalesce_step(pool, NULL);
+    assert(done);
+    for (size_t i = 0; i < 32; ++i)
+        assert(((unsigned char *) a)[i] == 0x5A);
+
+    // The merged block is indexed, the busy one is never handed out again
+    void *merged = pool_dyn_alloc(pool, 32 + sizeof(MetaData) + 64);
+    assert(merged == c);
+    void *block;
+    while ((block = pool_dyn_alloc(pool, 32)))
+        assert(block != a);
+    pool_dyn_destroy(pool);
+
+    done = pool_dyn_coalesce_step(NULL, NULL);
+    assert(done && pool_last_error == POOL_NULL_PTR);
+    printf("test_dynamic_pool_coalesce_step: OK\n");
+}
+
+// The statistics agree with the pool: every byte is either busy or free
+static void check_stats(PoolDyn *pool, PoolDynStats *stats)
+{
+    pool_dyn_stats(pool, stats);
+    assert(pool_last_error == POOL_OK);
+    assert(stats->free_bytes + pool_dyn_size(pool) == pool_dyn_capacity(pool));
+    assert(stats->largest_free <= stats->free_bytes);
+    size_t counted = 0;
+    for (size_t i = 0; i < DYN_STATS_BUCKETS; ++i)
+        counted += stats->histogram[i];
+    assert(counted == stats->free_blocks);
+
+    // The largest size is checked against the list of all blocks
+    if (pool->flags & POOL_DYN_COMPACT)
+        return;
+    size_t largest = 0;
+    for (PoolDyn *arena = pool; arena; arena = arena->next_arena)
+        for (MetaData *meta = arena->mem_pool; meta; meta = meta->next_block)
+            if (meta->canary == CANARY_FREE && meta->size > largest)
+                largest = meta->size;
+    assert(stats->largest_free == largest);
+}
+
+void test_dynamic_pool_stats(void)
+{
+    const PoolDynOptions modes[] = {
+        { .flags = 0 },
+        { .flags = POOL_DYN_TLSF },
+        { .flags = POOL_DYN_COMPACT },
+        { .flags = POOL_DYN_TLSF, .growth = POOL_DYN_GROW_DOUBLE }};
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(4096, &modes[m]);
+        assert(pool != NULL);
+        PoolDynStats stats;
+
+        // A new pool is a single free block
+        check_stats(pool, &stats);
+        assert(stats.free_blocks == 1);
+        assert(stats.largest_free == stats.free_bytes);
+
+        // Every other block is freed, the free ones cannot merge
+        void *blocks[16];
+        for (size_t i = 0; i < 16; ++i)
+        {
+            blocks[i] = pool_dyn_alloc(pool, 100);
+            assert(blocks[i] != NULL);
+        }
+        for (size_t i = 0; i < 16; i += 2)
+            pool_dyn_free(pool, blocks[i]);
+        check_stats(pool, &stats);
+        assert(stats.free_blocks == 9);
+        size_t largest = stats.largest_free;
+
+        // Taking the largest block leaves the exact size of the next one
+        void *tail = pool_dyn_alloc(pool, largest - 64);
+        assert(tail != NULL);
+        check_stats(pool, &stats);
+        assert(stats.largest_free < largest);
+
+        // A request larger than any free block fails without a search
+        if (!modes[m].growth)
+        {
+            void *too_large = pool_dyn_alloc(pool, stats.largest_free + 1);
+            assert(too_large == NULL);
+            assert(pool_last_error == POOL_ALLOC_FAILED);
+        }
+
+        // The merges are accounted for, the freed pool is one block again
+        pool_dyn_free(pool, tail);
+        for (size_t i = 1; i < 16; i += 2)
+            pool_dyn_free(pool, blocks[i]);
+        check_stats(pool, &stats);
+        if (!pool->next_arena)
+        {
+            assert(stats.free_blocks == 1);
+            assert(stats.largest_free == stats.free_bytes);
+        }
+
+        // Clearing resets the statistics to the first arena
+        pool_dyn_clear(pool);
+        check_stats(pool, &stats);
+        assert(stats.free_blocks == 1);
+        pool_dyn_destroy(pool);
+    }
+
+    // Splitting the largest (tail) block keeps its size exact, no walk is needed
+    for (size_t m = 0; m < 2; ++m)
+    {
+        PoolDyn *pool = pool_dyn_create_ex(64 * 1024, &modes[m]);
+        assert(pool != NULL);
+        PoolDynStats stats;
+        void *prev = NULL, *block;
+        while ((block = pool_dyn_alloc(pool, 48)))
+        {
+            assert(pool->largest_exact);
+            if (prev)
+                pool_dyn_free(pool, prev);
+            prev = (prev) ? NULL : block;
+        }
+        check_stats(pool, &stats);
+        pool_dyn_destroy(pool);
+    }
+
+    PoolDynStats stats;
+    pool_dyn_stats(NULL, &stats);
+    assert(pool_last_error == POOL_NULL_PTR);
+    printf("test_dynamic_pool_stats: OK\n");
+}
@@ -0,0 +1,172 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pool_errors.h>
+#include <pool_alloc.h>
+
+#define ALLOC_ROUNDS 1000
+
+void test_pool_alloc_size_classes(void)
+{
+    // Every class serves the sizes between the previous class and itself
+    size_t previous = 0;
+    for (size_t i = 0; i < SIZE_CLASS_COUNT; ++i)
+    {
+        size_t class_size = pool_size_class_size(i);
+        assert(class_size > previous);
+        assert(class_size % BLOCK_POOL_ALIGNMENT == 0);
+        assert(pool_size_class(previous + 1) == i);
+        assert(pool_size_class(class_size) == i);
+        previous = class_size;
+    }
+
+    assert(pool_size_class(0) == 0);
+    assert(pool_size_class_size(0) == SIZE_CLASS_MIN);
+    assert(pool_size_class_size(SIZE_CLASS_COUNT - 1) == SIZE_CLASS_MAX);
+    assert(pool_size_class(100) == pool_size_class(128));
+    assert(pool_size_class(97) != pool_size_class(96));
+
+    printf("test_pool_alloc_size_classes: OK\n");
+}
+
+void test_pool_alloc_mixed(void)
+{
+    PoolAlloc *pa = pool_alloc_create(1024, 64 * 1024);
+    assert(pa != NULL);
+
+    // Mixed sizes, each block filled with its own pattern
+    static void *blocks[ALLOC_ROUNDS];
+    for (size_t i = 0; i < ALLOC_ROUNDS; ++i)
+    {
+        size_t size = (i * 37) % SIZE_CLASS_MAX + 1;
+        blocks[i] = pool_malloc(pa, size);
+        assert(blocks[i] != NULL);
+        assert((uintptr_t) blocks[i] % BLOCK_POOL_ALIGNMENT == 0);
+        memset(blocks[i], (int) (i & 0xFF), size);
+    }
+
+    for (size_t i = 0; i < ALLOC_ROUNDS; ++i)
+    {
+        size_t size = (i * 37) % SIZE_CLASS_MAX + 1;
+        const unsigned char *data = blocks[i];
+        assert(data[0] == (i & 0xFF) && data[size - 1] == (i & 0xFF));
+    }
+
+    // Large requests go to the dynamic pool
+    void *large = pool_malloc(pa, 10000);
+    assert(large != NULL);
+    memset(large, 0xAB, 10000);
+
+    for (size_t i = 0; i < ALLOC_ROUNDS; i += 2)
+    {
+        pool_free(pa, blocks[i]);
+        assert(pool_last_error == POOL_OK);
+    }
+    pool_free(pa, large);
+    assert(pool_last_error == POOL_OK);
+
+    // The dynamic pool grows beyond its first arena
+    void *larger = pool_malloc(pa, 256 * 1024);
+    assert(larger != NULL);
+    memset(larger, 0xCD, 256 * 1024);
+    pool_free(pa, larger);
+    assert(pool_last_error == POOL_OK);
+
+    // Double free and foreign pointers are rejected
+    pool_free(pa, blocks[0]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    int dummy;
+    pool_free(pa, &dummy);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_free(pa, NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+
+    // Freed blocks are reused by the same class
+    void *again = pool_malloc(pa, 8);
+    assert(again != NULL);
+    pool_free(pa, again);
+
+    for (size_t i = 1; i < ALLOC_ROUNDS; i += 2)
+        pool_free(pa, blocks[i]);
+    assert(pool_last_error == POOL_OK);
+
+    // Without the dynamic pool the large requests fail
+    PoolAlloc *small = pool_alloc_create(0, 0);
+    assert(small != NULL);
+    void *too_large = pool_malloc(small, SIZE_CLASS_MAX + 1);
+    assert(too_large == NULL);
+    assert(pool_last_error == POOL_ALLOC_FAILED);
+    void *largest = pool_malloc(small, SIZE_CLASS_MAX);
+    assert(largest != NULL);
+
+    pool_alloc_destroy(small);
+    pool_alloc_destroy(pa);
+    printf("test_pool_alloc_mixed: OK\n");
+}
+
+#define ANY_POOLS 1000
+
+void test_pool_free_any(void)
+{
+    // Blocks of many pools freed without knowing their pools
+    static PoolBlock *pools[ANY_POOLS];
+    static void *blocks[ANY_POOLS];
+    PoolBlockOptions growable = { .growth = POOL_GROW_DOUBLE };
+    for (size_t i = 0; i < ANY_POOLS; ++i)
+    {
+        pools[i] = pool_block_create_ex(2, 16 + i % 64, (i % 2) ? &growable : NULL);
+        assert(pools[i] != NULL);
+        blocks[i] = pool_block_alloc(pools[i]);
+        assert(blocks[i] != NULL);
+    }
+
+    for (size_t i = 0; i < ANY_POOLS; ++i)
+    {
+        pool_free_any(blocks[i]);
+        assert(pool_last_error == POOL_OK);
+        assert(pool_block_size(pools[i]) == 0);
+    }
+
+    // Double free, interior pointers and foreign memory are rejected
+    pool_free_any(blocks[0]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    blocks[0] = pool_block_alloc(pools[0]);
+    pool_free_any((char *) blocks[0] + 1);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    int dummy;
+    pool_free_any(&dummy);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_free_any(NULL);
+    assert(pool_last_error == POOL_NULL_PTR);
+
+    // Dynamic pools are found as well
+    PoolDyn *dyn = pool_dyn_create(1024);
+    assert(dyn != NULL);
+    void *block = pool_dyn_alloc(dyn, 100);
+    size_t used = pool_dyn_size(dyn);
+    pool_free_any(block);
+    assert(pool_last_error == POOL_OK);
+    assert(pool_dyn_size(dyn) < used);
+
+    // A destroyed pool is no longer known
+    void *stale = pool_block_alloc(pools[1]);
+    pool_block_destroy(pools[1]);
+    pool_free_any(stale);
+    assert(pool_last_error == POOL_INVALID_PTR);
+
+    // The allocator rejects the blocks of other pools
+    PoolAlloc *pa = pool_alloc_create(0, 0);
+    assert(pa != NULL);
+    pool_free(pa, blocks[0]);
+    assert(pool_last_error == POOL_INVALID_PTR);
+    pool_free_any(pool_malloc(pa, 24));
+    assert(pool_last_error == POOL_OK);
+
+    pool_alloc_destroy(pa);
+    pool_dyn_destroy(dyn);
+    for (size_t i = 0; i < ANY_POOLS; ++i)
+        if (i != 1)
+            pool_block_destroy(pools[i]);
+    printf("test_pool_free_any: OK\n");
+}
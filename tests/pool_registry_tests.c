@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pool_registry.h>
+
+#define REGISTRY_PAGES 3
+
+void test_pool_registry_basic(void)
+{
+    size_t size = REGISTRY_PAGES * REGISTRY_PAGE_SIZE;
+    char *range = aligned_alloc(REGISTRY_PAGE_SIZE, size);
+    assert(range != NULL);
+    int owner;
+    PoolKind kind;
+
+    assert(pool_registry_find(range, &kind) == NULL);
+    assert(kind == POOL_KIND_NONE);
+
+    bool added = pool_registry_add(range, size, &owner, POOL_KIND_DYN);
+    assert(added);
+    assert(pool_registry_find(range, &kind) == &owner);
+    assert(kind == POOL_KIND_DYN);
+    assert(pool_registry_find(range + size - 1, &kind) == &owner);
+    assert(pool_registry_find(range + size / 2, NULL) == &owner);
+
+    // Unaligned ranges are rejected
+    added = pool_registry_add(range + 8, REGISTRY_PAGE_SIZE, &owner, POOL_KIND_BLOCK);
+    assert(!added);
+    added = pool_registry_add(NULL, REGISTRY_PAGE_SIZE, &owner, POOL_KIND_BLOCK);
+    assert(!added);
+
+    pool_registry_remove(range, size);
+    assert(pool_registry_find(range, &kind) == NULL);
+    assert(kind == POOL_KIND_NONE);
+    assert(pool_registry_find(range + size - 1, NULL) == NULL);
+
+    free(range);
+    printf("test_pool_registry_basic: OK\n");
+}
+
+void test_pool_registry_spans(void)
+{
+    /**
+     * The registry never touches the memory, so a range much larger than
+     * the available memory can be registered at an unused address. It
+     * starts inside a leaf, covers a whole root slot and ends inside a leaf.
+     */
+    char *base = (char *) ((uintptr_t) 1 << 44);
+    char *range = base + 5 * REGISTRY_PAGE_SIZE;
+    size_t size = ((size_t) 64 << 30) + ((size_t) 40 << 20);
+    char *next = range + size;
+    int owner, neighbour;
+    PoolKind kind;
+
+    bool added = pool_registry_add(range, size, &owner, POOL_KIND_DYN);
+    assert(added);
+    added = pool_registry_add(next, REGISTRY_PAGE_SIZE, &neighbour, POOL_KIND_BLOCK);
+    assert(added);
+    assert(pool_registry_find(range - 1, NULL) == NULL);
+    assert(pool_registry_find(range, &kind) == &owner && kind == POOL_KIND_DYN);
+    assert(pool_registry_find(base + ((size_t) 16 << 20), NULL) == &owner);
+    assert(pool_registry_find(base + ((size_t) 64 << 30), NULL) == &owner);
+    assert(pool_registry_find(range + size / 2, NULL) == &owner);
+    assert(pool_registry_find(next - 1, NULL) == &owner);
+    assert(pool_registry_find(next, &kind) == &neighbour && kind == POOL_KIND_BLOCK);
+
+    // The removal clears the whole spans and the pages, not the neighbour
+    pool_registry_remove(range, size);
+    assert(pool_registry_find(range, NULL) == NULL);
+    assert(pool_registry_find(base + ((size_t) 16 << 20), NULL) == NULL);
+    assert(pool_registry_find(range + size / 2, NULL) == NULL);
+    assert(pool_registry_find(next - 1, NULL) == NULL);
+    assert(pool_registry_find(next, NULL) == &neighbour);
+
+    // A smaller range inside the former spans is found through the pages
+    added = pool_registry_add(base + ((size_t) 32 << 20), REGISTRY_PAGE_SIZE, &owner,
+            POOL_KIND_DYN);
+    assert(added);
+    assert(pool_registry_find(base + ((size_t) 32 << 20), NULL) == &owner);
+    assert(pool_registry_find(base + ((size_t) 32 << 20) + REGISTRY_PAGE_SIZE, NULL) == NULL);
+    pool_registry_remove(base + ((size_t) 32 << 20), REGISTRY_PAGE_SIZE);
+    pool_registry_remove(next, REGISTRY_PAGE_SIZE);
+    assert(pool_registry_find(next, NULL) == NULL);
+
+    printf("test_pool_registry_spans: OK\n");
+}
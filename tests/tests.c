@@ -10,6 +10,28 @@ int main() {
     test_block_pool_overflow();
     test_block_pool_invalid_free();
     test_block_pool_alignment();
+    test_block_pool_free_list();
+    test_block_pool_bitmap();
+    test_block_pool_growable();
+    test_block_pool_batch();
+    test_block_pool_clear_epoch();
+    test_block_pool_aligned();
+    test_block_pool_foreach();
+    test_block_pool_handles();
+    test_block_pool_calloc();
+    test_block_pool_huge_pages();
+    test_block_pool_trim();
+
+    // Typed block pool tests
+    test_block_pool_typed();
+
+    // Thread-safe block pool tests
+    test_block_pool_mag_basic();
+    test_block_pool_mag_threads();
+
+    // Lock-free block pool tests
+    test_block_pool_atomic_basic();
+    test_block_pool_atomic_stress();
 
     // Dynamic pool tests
     test_dynamic_pool_basic();
@@ -18,6 +40,27 @@ int main() {
     test_dynamic_pool_alignment();
     test_dynamic_pool_coalesce();
     test_dynamic_pool_block_recovery();
+    test_dynamic_pool_aligned();
+    test_dynamic_pool_tlsf();
+    test_dynamic_pool_realloc();
+    test_dynamic_pool_alloc_aligned();
+    test_dynamic_pool_calloc();
+    test_dynamic_pool_compact();
+    test_dynamic_pool_integrity();
+    test_dynamic_pool_huge_pages();
+    test_dynamic_pool_growth();
+    test_dynamic_pool_trim();
+    test_dynamic_pool_coalesce_step();
+    test_dynamic_pool_stats();
+
+    // Size-class allocator tests
+    test_pool_alloc_size_classes();
+    test_pool_alloc_mixed();
+    test_pool_free_any();
+
+    // Pool registry tests
+    test_pool_registry_basic();
+    test_pool_registry_spans();
 
     printf("All tests passed!\n");
     return 0;
@@ -23,6 +23,89 @@ void test_block_pool_invalid_free(void);
  */
 void test_block_pool_alignment(void);
 
+/**
+ * @brief Testing the reuse of freed blocks and double free detection.
+ */
+void test_block_pool_free_list(void);
+
+/**
+ * @brief Testing the pool with the busy flags stored in a bitmap.
+ */
+void test_block_pool_bitmap(void);
+
+/**
+ * @brief Testing the growth and shrinking of a growable pool.
+ */
+void test_block_pool_growable(void);
+
+/**
+ * @brief Testing allocation and release of blocks in batches.
+ */
+void test_block_pool_batch(void);
+
+/**
+ * @brief Testing the cleanup by epoch and detection of stale frees.
+ */
+void test_block_pool_clear_epoch(void);
+
+/**
+ * @brief Testing pools with larger alignments and cache-line padding.
+ */
+void test_block_pool_aligned(void);
+
+/**
+ * @brief Testing the iteration over the busy blocks.
+ */
+void test_block_pool_foreach(void);
+
+/**
+ * @brief Testing the generational handles.
+ */
+void test_block_pool_handles(void);
+
+/**
+ * @brief Testing the zero-filled allocation.
+ */
+void test_block_pool_calloc(void);
+
+/**
+ * @brief Testing the slab buffers backed by huge pages.
+ */
+void test_block_pool_huge_pages(void);
+
+/**
+ * @brief Testing the release of the pages of free blocks.
+ */
+void test_block_pool_trim(void);
+
+// Typed block pool tests
+/**
+ * @brief Testing the pools specialized for one type at compile time.
+ */
+void test_block_pool_typed(void);
+
+// Thread-safe block pool tests
+/**
+ * @brief Testing allocation and release through the magazines.
+ */
+void test_block_pool_mag_basic(void);
+
+/**
+ * @brief Testing concurrent use of the pool by several threads.
+ */
+void test_block_pool_mag_threads(void);
+
+// Lock-free block pool tests
+/**
+ * @brief Testing allocation, release and cleanup of the lock-free pool.
+ */
+void test_block_pool_atomic_basic(void);
+
+/**
+ * @brief Stress test: many threads allocating and freeing concurrently.
+ */
+void test_block_pool_atomic_stress(void);
+
 // Dynamic pool tests
 /**
  * @brief We check the operation of the main operations (allocation,
@@ -55,4 +138,91 @@ void test_dynamic_pool_coalesce(void);
  */
 void test_dynamic_pool_block_recovery(void);
 
+/**
+ * @brief Testing pools with larger block alignments.
+ */
+void test_dynamic_pool_aligned(void);
+
+/**
+ * @brief Testing the pool with the index of free blocks.
+ */
+void test_dynamic_pool_tlsf(void);
+
+/**
+ * @brief Testing the size change of allocated memory.
+ */
+void test_dynamic_pool_realloc(void);
+
+/**
+ * @brief Testing the allocation with a larger alignment than the pool has.
+ */
+void test_dynamic_pool_alloc_aligned(void);
+
+/**
+ * @brief Testing the zero-filled allocation.
+ */
+void test_dynamic_pool_calloc(void);
+
+/**
+ * @brief Testing the pools with compact block headers.
+ */
+void test_dynamic_pool_compact(void);
+
+/**
+ * @brief Testing the integrity levels of the block headers.
+ */
+void test_dynamic_pool_integrity(void);
+
+/**
+ * @brief Testing the pools backed by huge pages and blocks above 4 GiB.
+ */
+void test_dynamic_pool_huge_pages(void);
+
+/**
+ * @brief Testing the growable pools made of several arenas.
+ */
+void test_dynamic_pool_growth(void);
+
+/**
+ * @brief Testing the release of the pages inside free blocks.
+ */
+void test_dynamic_pool_trim(void);
+
+/**
+ * @brief Testing the incremental merging of free blocks.
+ */
+void test_dynamic_pool_coalesce_step(void);
+
+/**
+ * @brief Testing the statistics of the free blocks.
+ */
+void test_dynamic_pool_stats(void);
+
+// Size-class allocator tests
+/**
+ * @brief Testing the mapping of sizes to size classes.
+ */
+void test_pool_alloc_size_classes(void);
+
+/**
+ * @brief Testing allocation and release of mixed sizes.
+ */
+void test_pool_alloc_mixed(void);
+
+/**
+ * @brief Testing release of memory without knowing its pool.
+ */
+void test_pool_free_any(void);
+
+// Pool registry tests
+/**
+ * @brief Testing registration, lookup and removal of address ranges.
+ */
+void test_pool_registry_basic(void);
+
+/**
+ * @brief Testing the ranges covering whole spans of the inner nodes.
+ */
+void test_pool_registry_spans(void);
+
 #endif // TESTS_H